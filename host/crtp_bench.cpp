@@ -0,0 +1,187 @@
+/*
+    Abstraction layer for EEPROM ICs.
+
+    Copyright (C) 2012..2016 Uladzimir Pylinski aka barthess
+
+    This file is part of 24AA lib.
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/*
+ * Compares cost of runtime (MtdBase) and compile time specialized
+ * (MtdBaseT) front ends on identical RAM backed devices. Images are
+ * compared at the end, so it doubles as correctness test of template.
+ * Linked with nvram_lean, so both front ends have the same feature set.
+ * Numbers are host nanoseconds, they say nothing about target cycles.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+
+#include "ch.hpp"
+#include "hal.h"
+
+#include "mtd_mmap.hpp"
+#include "mtd_mmap_t.hpp"
+
+using namespace nvram;
+
+/*
+ ******************************************************************************
+ * DEFINES
+ ******************************************************************************
+ */
+
+/* 24AA512 geometry */
+#define PAGESIZE              128
+#define PAGES                 512
+#define ADDR_LEN              2
+#define CAPACITY              (PAGESIZE * PAGES)
+
+#define ITERATIONS            20000
+
+/*
+ ******************************************************************************
+ * EXTERNS
+ ******************************************************************************
+ */
+
+/*
+ ******************************************************************************
+ * GLOBAL VARIABLES
+ ******************************************************************************
+ */
+
+struct bench_case_t {
+  const char    *name;
+  bool          write;
+  size_t        len;
+  uint32_t      stride;   /* offset step between iterations */
+};
+
+static const bench_case_t cases[] = {
+    {"write16",   true,  16,   112},
+    {"writepage", true,  128,  128},
+    {"write1k",   true,  1024, 133},
+    {"read16",    false, 16,   112},
+    {"read1k",    false, 1024, 133},
+};
+
+static uint8_t databuf[1024];
+
+/*
+ *******************************************************************************
+ *******************************************************************************
+ * LOCAL FUNCTIONS
+ *******************************************************************************
+ *******************************************************************************
+ */
+
+/**
+ * @brief   Runs single case, returns nanoseconds per operation.
+ */
+template <typename Mtd>
+static double run(Mtd *mtd, const bench_case_t *c) {
+  const auto start = std::chrono::steady_clock::now();
+  uint32_t offset = 0;
+
+  for (size_t i=0; i<ITERATIONS; i++) {
+    size_t status;
+    databuf[0] = i;
+    if (c->write)
+      status = mtd->write(databuf, c->len, offset);
+    else
+      status = mtd->read(databuf, c->len, offset);
+    osalDbgCheck(c->len == status);
+    offset = (offset + c->stride) % (CAPACITY - c->len);
+  }
+
+  const auto stop = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::nano>(stop - start).count() / ITERATIONS;
+}
+
+/**
+ *
+ */
+static void usage(const char *name) {
+  fprintf(stderr, "Usage: %s IMAGE\n", name);
+}
+
+/**
+ *
+ */
+int main(int argc, char *argv[]) {
+
+  if (2 != argc) {
+    usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  const MtdConfig cfg = {
+      MS2ST(5),
+      0,
+      PAGES,
+      PAGESIZE,
+      ADDR_LEN,
+      400000,
+      nullptr,
+      nullptr,
+      nullptr,
+      nullptr,
+      nullptr,
+      nullptr,
+      nullptr,
+      nullptr,
+      nullptr,
+      nullptr,
+      0,
+      0,
+  };
+  static uint8_t workbuf[PAGESIZE + ADDR_LEN];
+  uint8_t *image = static_cast<uint8_t *>(malloc(CAPACITY));
+  uint8_t *check = static_cast<uint8_t *>(malloc(CAPACITY));
+  osalDbgCheck((nullptr != image) && (nullptr != check));
+  memset(image, 0xFF, CAPACITY);
+
+  chibios_rt::System::init();
+
+  MtdMmap rt(cfg, workbuf, sizeof(workbuf), argv[1]);
+  if (OSAL_SUCCESS != rt.open()) {
+    perror(argv[1]);
+    return EXIT_FAILURE;
+  }
+  osalDbgCheck(CAPACITY == rt.write(image, CAPACITY, 0));
+  MtdMmapT<PAGESIZE, PAGES, ADDR_LEN> ct(image);
+
+  printf("crtp,case,size,runtime_ns,template_ns\n");
+  for (size_t i=0; i<sizeof(cases)/sizeof(cases[0]); i++) {
+    const double r = run(&rt, &cases[i]);
+    const double t = run(&ct, &cases[i]);
+    printf("crtp,%s,%u,%.1f,%.1f\n", cases[i].name, (unsigned)cases[i].len, r, t);
+  }
+
+  /* both front ends must leave identical content */
+  osalDbgCheck(CAPACITY == rt.read(check, CAPACITY, 0));
+  if (0 != memcmp(check, image, CAPACITY)) {
+    fprintf(stderr, "images differ\n");
+    return EXIT_FAILURE;
+  }
+
+  rt.close();
+  free(image);
+  free(check);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,256 @@
+/*
+    Abstraction layer for EEPROM ICs.
+
+    Copyright (C) 2012..2016 Uladzimir Pylinski aka barthess
+
+    This file is part of 24AA lib.
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/*
+ * Runs I2C drivers (runtime Mtd24aa and template Mtd24aaT) against
+ * emulated 24xx memory on host I2C bus. Device clock is virtual, so
+ * bus times printed are emulated 400 kHz bus time.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "ch.hpp"
+#include "hal.h"
+#include "chprintf.h"
+
+#include "mtd_24aa.hpp"
+#include "mtd_24aa_t.hpp"
+#include "nvram_test_suite.hpp"
+
+using namespace nvram;
+
+/*
+ ******************************************************************************
+ * DEFINES
+ ******************************************************************************
+ */
+
+/* 24AA128 geometry */
+#define PAGESIZE              64
+#define PAGES                 256
+#define ADDR_LEN              2
+#define CAPACITY              (PAGESIZE * PAGES)
+
+#define EEPROM_ADDR           0x50
+#define BUS_CLK               400000
+#define PROGRAM_US            5000
+
+/*
+ ******************************************************************************
+ * EXTERNS
+ ******************************************************************************
+ */
+
+/*
+ ******************************************************************************
+ * GLOBAL VARIABLES
+ ******************************************************************************
+ */
+
+static uint8_t image[CAPACITY];
+static uint8_t mtdbuf[CAPACITY];
+static uint8_t refbuf[CAPACITY];
+static uint8_t filebuf[CAPACITY];
+
+/*
+ *******************************************************************************
+ *******************************************************************************
+ * LOCAL FUNCTIONS
+ *******************************************************************************
+ *******************************************************************************
+ */
+
+/**
+ * @brief   Whole test suite through runtime driver.
+ */
+static bool runtime_test(void) {
+  I2CDriver i2c;
+  const MtdConfig cfg = {
+      US2ST(PROGRAM_US),
+      0,
+      PAGES,
+      PAGESIZE,
+      ADDR_LEN,
+      BUS_CLK,
+      nullptr,
+      nullptr,
+      nullptr,
+      nullptr,
+      nullptr,
+      nullptr,
+      nullptr,
+      nullptr,
+      nullptr,
+      nullptr,
+      MS2ST(1),
+      MS2ST(20),
+  };
+  static uint8_t workbuf[PAGESIZE + ADDR_LEN + 1];
+
+  hostI2cInit(&i2c, EEPROM_ADDR, image, CAPACITY, PAGESIZE, ADDR_LEN,
+              BUS_CLK, PROGRAM_US);
+  Mtd24aa mtd(cfg, workbuf, sizeof(workbuf), &i2c, EEPROM_ADDR);
+
+  TestContext ctx;
+  ctx.mtd     = &mtd;
+  ctx.mtdbuf  = mtdbuf;
+  ctx.refbuf  = refbuf;
+  ctx.filebuf = filebuf;
+  ctx.len     = CAPACITY;
+  ctx.chn     = hostStdout();
+
+  const bool status = TestSuite(&ctx);
+  printf("runtime: transfers=%u nacks=%u\n", i2c.transfers, i2c.nacks);
+  return status;
+}
+
+/**
+ * @brief   Driver sleeps half of real program time, so completion
+ *          is detected by ACK polling only.
+ */
+static bool template_test(void) {
+  static I2CDriver i2c;
+  /* write buffer is member, keep it off the stack as on target */
+  static Mtd24aaT<PAGESIZE, PAGES, ADDR_LEN> mtd(&i2c, EEPROM_ADDR,
+                                                 US2ST(PROGRAM_US / 2), BUS_CLK);
+
+  hostI2cInit(&i2c, EEPROM_ADDR, image, CAPACITY, PAGESIZE, ADDR_LEN,
+              BUS_CLK, PROGRAM_US);
+  for (size_t i=0; i<CAPACITY; i++)
+    refbuf[i] = rand();
+
+  /* unaligned offsets cross page boundaries */
+  for (uint32_t offset=0; offset<CAPACITY; ) {
+    const size_t len = ((offset + 100) < CAPACITY) ? 100 : CAPACITY - offset;
+    if (len != mtd.write(&refbuf[offset], len, offset))
+      return OSAL_FAILED;
+    offset += len;
+  }
+  if ((CAPACITY != mtd.read(mtdbuf, CAPACITY, 0)) ||
+      (0 != memcmp(mtdbuf, refbuf, CAPACITY)) ||
+      (0 != memcmp(image, refbuf, CAPACITY)))
+    return OSAL_FAILED;
+  printf("template: transfers=%u nacks=%u\n", i2c.transfers, i2c.nacks);
+  if (0 == i2c.nacks)
+    return OSAL_FAILED;
+
+  /* device slower than twice programtime must fail the write */
+  i2c.program_us = 2 * PROGRAM_US + 1000;
+  if (0 != mtd.write(refbuf, PAGESIZE, 0))
+    return OSAL_FAILED;
+
+  return OSAL_SUCCESS;
+}
+
+/**
+ * @brief   Writes 1 kB to FRAM with given write buffer.
+ * @return  Number of I2C transactions, 0 on error.
+ */
+static uint32_t fram_write(size_t writebuf_size, uint64_t *bus_us) {
+  I2CDriver i2c;
+  const MtdConfig cfg = {
+      0,
+      0,
+      1,
+      CAPACITY,
+      ADDR_LEN,
+      BUS_CLK,
+      nullptr,
+      nullptr,
+      nullptr,
+      nullptr,
+      nullptr,
+      nullptr,
+      nullptr,
+      nullptr,
+      nullptr,
+      nullptr,
+      0,
+      0,
+  };
+  static uint8_t workbuf[256 + ADDR_LEN];
+  uint64_t start;
+
+  osalDbgCheck(writebuf_size <= sizeof(workbuf));
+  hostI2cInit(&i2c, EEPROM_ADDR, image, CAPACITY, CAPACITY, ADDR_LEN,
+              BUS_CLK, 0);
+  Mtd24aa mtd(cfg, workbuf, writebuf_size, &i2c, EEPROM_ADDR);
+
+  for (size_t i=0; i<1024; i++)
+    refbuf[i] = rand();
+  start = hostClockNowUs();
+  if (1024 != mtd.write(refbuf, 1024, 100))
+    return 0;
+  *bus_us = hostClockNowUs() - start;
+  if (0 != memcmp(&image[100], refbuf, 1024))
+    return 0;
+
+  return i2c.transfers;
+}
+
+/**
+ * @brief   FRAM transaction count is bounded by write buffer only,
+ *          test_app buffer must give 4 transactions per kilobyte.
+ */
+static bool fram_test(void) {
+  uint64_t small_us, big_us;
+  const uint32_t small = fram_write(32 + ADDR_LEN, &small_us);
+  const uint32_t big = fram_write(256 + ADDR_LEN, &big_us);
+
+  printf("fram 1k write: writebuf 34: %u transfers %u us, "
+         "writebuf 258: %u transfers %u us\n",
+         small, (unsigned)small_us, big, (unsigned)big_us);
+
+  if ((32 != small) || (4 != big) || (big_us >= small_us))
+    return OSAL_FAILED;
+  return OSAL_SUCCESS;
+}
+
+/*
+ ******************************************************************************
+ * EXPORTED FUNCTIONS
+ ******************************************************************************
+ */
+
+/**
+ *
+ */
+int main(void) {
+
+  chibios_rt::System::init();
+  hostClockSetVirtual(true);
+
+  if (OSAL_SUCCESS != runtime_test()) {
+    fprintf(stderr, "runtime driver failed\n");
+    return EXIT_FAILURE;
+  }
+  if (OSAL_SUCCESS != template_test()) {
+    fprintf(stderr, "template driver failed\n");
+    return EXIT_FAILURE;
+  }
+  if (OSAL_SUCCESS != fram_test()) {
+    fprintf(stderr, "fram transaction count failed\n");
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
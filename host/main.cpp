@@ -0,0 +1,278 @@
+/*
+    Abstraction layer for EEPROM ICs.
+
+    Copyright (C) 2012..2016 Uladzimir Pylinski aka barthess
+
+    This file is part of 24AA lib.
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "ch.hpp"
+#include "hal.h"
+#include "chprintf.h"
+
+#include "mtd_mmap.hpp"
+#include "nvram_test_suite.hpp"
+#include "nvram_bench.hpp"
+
+using namespace nvram;
+
+/*
+ ******************************************************************************
+ * DEFINES
+ ******************************************************************************
+ */
+
+/*
+ ******************************************************************************
+ * EXTERNS
+ ******************************************************************************
+ */
+
+#define EVENT_DEPTH           8
+
+/*
+ ******************************************************************************
+ * GLOBAL VARIABLES
+ ******************************************************************************
+ */
+
+/* open events of calling thread, nested calls (shadow) go deeper */
+static thread_local mtd_event_t event_stack[EVENT_DEPTH];
+static thread_local size_t event_depth = 0;
+static thread_local uint64_t event_wall[EVENT_DEPTH];
+static uint32_t event_cnt = 0;
+
+/*
+ *******************************************************************************
+ *******************************************************************************
+ * LOCAL FUNCTIONS
+ *******************************************************************************
+ *******************************************************************************
+ */
+
+/**
+ * @brief   Profiling hook checking that every END event closes
+ *          matching BEGIN event.
+ */
+static void event_check(MtdBase *mtd, const mtd_event_t *ev) {
+  (void)mtd;
+
+  if ((MTD_EVENT_OP_BEGIN == ev->type) || (MTD_EVENT_BUS_BEGIN == ev->type)) {
+    osalDbgCheck((event_depth < EVENT_DEPTH) && (0 == ev->done));
+    osalDbgCheck(ev->t_begin == ev->t_end);
+    event_wall[event_depth] = hostClockNowUs();
+    event_stack[event_depth++] = *ev;
+  }
+  else {
+    osalDbgCheck(event_depth > 0);
+    const mtd_event_t *b = &event_stack[--event_depth];
+    osalDbgCheck((b->type + 1) == ev->type);
+    osalDbgCheck((b->op == ev->op) && (b->offset == ev->offset));
+    osalDbgCheck((b->len >= ev->len) && (b->t_begin == ev->t_begin));
+    osalDbgCheck(ev->done <= ev->len);
+    /* library can not measure more than host clock did, wrapped
+       conversion of absolute time shows up as ~2^32 uS here. Host
+       may preempt between timestamp and hook, hence big slack */
+    const uint64_t wall = hostClockNowUs() - event_wall[event_depth];
+    const uint64_t dt = MTD_STATS_ELAPSED_US(b->t_begin, ev->t_end);
+    osalDbgCheck(dt <= wall + 1000000);
+    osalDbgCheck((OSAL_SUCCESS == ev->status) == (ev->done == ev->len));
+  }
+
+  event_cnt++;
+}
+
+/**
+ *
+ */
+static void usage(const char *name) {
+  fprintf(stderr, "Usage: %s [-b] [-t] IMAGE PAGESIZE PAGES [ADDR_LEN]\n", name);
+  fprintf(stderr, "       %s [-b] [-t] IMAGE PRESET\n", name);
+  fprintf(stderr, "  -b runs benchmarks instead of tests.\n");
+  fprintf(stderr, "  -t dumps trace of last operations at exit.\n");
+  fprintf(stderr, "  Set PAGES to 1 to emulate FRAM.\n");
+  fprintf(stderr, "  PRESET is timing model name (24aa512, 25aa640, fm24cl64,\n");
+  fprintf(stderr, "  fm25v02, s25fl512). Device time is counted by virtual clock.\n");
+}
+
+/**
+ *
+ */
+int main(int argc, char *argv[]) {
+
+  const MtdTiming *timing = nullptr;
+  const char *self = argv[0];
+  uint32_t pagesize, pages;
+  size_t addr_len;
+  bool bench = false;
+  bool trace = false;
+
+  while ((argc > 1) && ('-' == argv[1][0])) {
+    if (0 == strcmp("-b", argv[1]))
+      bench = true;
+    else if (0 == strcmp("-t", argv[1]))
+      trace = true;
+    else {
+      usage(self);
+      return EXIT_FAILURE;
+    }
+    argc--;
+    argv++;
+  }
+
+  if (3 == argc) {
+    timing = timing_find(argv[2]);
+    if (nullptr == timing) {
+      usage(self);
+      return EXIT_FAILURE;
+    }
+    pagesize = timing->pagesize;
+    pages = timing->pages;
+    addr_len = timing->addr_len;
+  }
+  else if (argc >= 4) {
+    pagesize = strtoul(argv[2], nullptr, 0);
+    pages = strtoul(argv[3], nullptr, 0);
+    addr_len = (argc > 4) ? strtoul(argv[4], nullptr, 0) : 2;
+  }
+  else {
+    usage(self);
+    return EXIT_FAILURE;
+  }
+
+  const size_t capacity = pagesize * pages;
+  systime_t programtime = MS2ST(5);
+  if (nullptr != timing)
+    programtime = US2ST(timing->program_us);
+
+  const MtdConfig cfg = {
+      (1 == pages) ? 0 : programtime,
+      (nullptr != timing) ? US2ST(timing->erase_us) : 0,
+      pages,
+      pagesize,
+      addr_len,
+      (nullptr != timing) ? timing->bus_clk : 400000,
+      nullptr,
+      nullptr,
+      nullptr,
+      nullptr,
+      nullptr,
+      nullptr,
+      nullptr,
+      nullptr,
+      event_check,
+      nullptr,
+      MS2ST(1),                     /* wakeuptime */
+      MS2ST(20),                    /* idletime */
+  };
+
+  /* whole page plus preamble must fit in write buffer */
+  size_t workbuf_size = MTD_WRITE_BUF_SIZE;
+  if ((pages > 1) && (workbuf_size < pagesize + addr_len + 1))
+    workbuf_size = pagesize + addr_len + 1;
+  uint8_t *workbuf = static_cast<uint8_t *>(malloc(workbuf_size));
+  osalDbgCheck(nullptr != workbuf);
+
+  chibios_rt::System::init();
+
+  MtdMmap mtd(cfg, workbuf, workbuf_size, argv[1]);
+  if (OSAL_SUCCESS != mtd.open()) {
+    perror(argv[1]);
+    return EXIT_FAILURE;
+  }
+  if (nullptr != timing) {
+    mtd.set_timing(timing);
+    hostClockSetVirtual(true);
+  }
+#if MTD_USE_WEAR
+  const size_t wear_blocks = capacity / mtd.wear_blocksize();
+  uint32_t *wear = static_cast<uint32_t *>(malloc(wear_blocks * sizeof(uint32_t)));
+  osalDbgCheck(nullptr != wear);
+  mtd.wear_start(wear, wear_blocks, MTD_WEAR_NO_REGION);
+#endif
+  const uint64_t start = hostClockNowUs();
+
+  uint8_t *mtdbuf  = static_cast<uint8_t *>(malloc(capacity));
+  uint8_t *refbuf  = static_cast<uint8_t *>(malloc(capacity));
+  uint8_t *filebuf = static_cast<uint8_t *>(malloc(capacity));
+  osalDbgCheck((nullptr != mtdbuf) && (nullptr != refbuf) && (nullptr != filebuf));
+
+  TestContext ctx;
+  ctx.mtd     = &mtd;
+  ctx.mtdbuf  = mtdbuf;
+  ctx.refbuf  = refbuf;
+  ctx.filebuf = filebuf;
+  ctx.len     = capacity;
+  ctx.chn     = hostStdout();
+
+  bool status;
+  if (bench) {
+    BenchContext bctx;
+    bctx.mtd     = &mtd;
+    bctx.buf     = mtdbuf;
+    bctx.len     = capacity;
+    bctx.samples = 0;
+    bctx.clock   = nullptr;
+    bctx.chn     = hostStdout();
+    status = Benchmark(&bctx);
+  }
+  else {
+    status = TestSuite(&ctx);
+  }
+
+#if MTD_USE_TRACE
+  if (trace)
+    mtd.trace_dump(hostStdout());
+#else
+  (void)trace;
+#endif
+
+#if MTD_USE_STATS
+  MtdStats st;
+  mtd.stats_get(&st);
+  stats_print(hostStdout(), &st);
+#endif
+
+#if MTD_USE_WEAR
+  mtd.wear_dump(hostStdout());
+#endif
+  printf("events=%u\n", event_cnt);
+
+  MtdCalib calib;
+  mtd.calib_get(&calib);
+  if (0 != calib.samples)
+    printf("calib: samples=%u min=%u avg=%u max=%u programtime=%u us\n",
+           calib.samples, calib.program_min_us, calib.program_avg_us,
+           calib.program_max_us, (unsigned)ST2US(calib.programtime));
+
+  if (nullptr != timing)
+    printf("%s: device time %llu ms\n", timing->name,
+           (unsigned long long)((hostClockNowUs() - start) / 1000));
+
+  free(mtdbuf);
+  free(refbuf);
+  free(filebuf);
+  mtd.close();
+  free(workbuf);
+#if MTD_USE_WEAR
+  free(wear);
+#endif
+
+  return (OSAL_SUCCESS == status) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,41 @@
+/*
+    Abstraction layer for EEPROM ICs.
+
+    Copyright (C) 2012..2016 Uladzimir Pylinski aka barthess
+
+    This file is part of 24AA lib.
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#ifndef MTD_CONF_H_
+#define MTD_CONF_H_
+
+#define MTD_USE_MUTUAL_EXCLUSION  TRUE
+#define MTD_WRITE_BUF_SIZE        (128 + 4)
+/* optional features may be switched off from build system */
+#if !defined(MTD_USE_STATS)
+#define MTD_USE_STATS             TRUE
+#endif
+#if !defined(MTD_USE_TRACE)
+#define MTD_USE_TRACE             TRUE
+#endif
+#define MTD_TRACE_DEPTH           1024
+#if !defined(MTD_USE_WEAR)
+#define MTD_USE_WEAR              TRUE
+#endif
+#if !defined(MTD_USE_POWER)
+#define MTD_USE_POWER             TRUE
+#endif
+
+#endif /* MTD_CONF_H_ */
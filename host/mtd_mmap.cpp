@@ -0,0 +1,284 @@
+/*
+    Abstraction layer for EEPROM ICs.
+
+    Copyright (C) 2012..2016 Uladzimir Pylinski aka barthess
+
+    This file is part of 24AA lib.
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include <cstring>
+#include <cstdlib>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "mtd_mmap.hpp"
+
+namespace nvram {
+
+/*
+ ******************************************************************************
+ * DEFINES
+ ******************************************************************************
+ */
+
+/*
+ ******************************************************************************
+ * EXTERNS
+ ******************************************************************************
+ */
+
+/*
+ ******************************************************************************
+ * PROTOTYPES
+ ******************************************************************************
+ */
+
+/*
+ ******************************************************************************
+ * GLOBAL VARIABLES
+ ******************************************************************************
+ */
+
+/*
+ ******************************************************************************
+ ******************************************************************************
+ * LOCAL FUNCTIONS
+ ******************************************************************************
+ ******************************************************************************
+ */
+
+/**
+ * @brief   Accepts data that can be fitted in single page boundary (for EEPROM)
+ *          or can be placed in write buffer (for FRAM)
+ */
+size_t MtdMmap::bus_write(const uint8_t *txdata, size_t len, uint32_t offset) {
+
+  osalDbgCheck((this->writebuf_size - cfg.addr_len) >= len);
+  osalDbgAssert((offset + len) <= capacity(), "Transaction out of device bounds");
+  osalDbgAssert(nullptr != image, "Image not opened");
+  osalDbgAssert(!asleep, "Device in power-down");
+
+  /* emulate real bus transaction: preamble followed by payload */
+  addr2buf(writebuf, offset, cfg.addr_len);
+  if (txdata != &writebuf[cfg.addr_len])
+    memcpy(&writebuf[cfg.addr_len], txdata, len);
+  memcpy(&image[offset], &writebuf[cfg.addr_len], len);
+
+  if (nullptr != timing) {
+    hostDelayUs(timing_write_us(timing, len));
+    busy_until = hostClockNowUs() + timing->program_typ_us;
+    if (0 != timing->program_typ_us) {
+      if (0 != programtime)
+        osalThreadSleep(programtime);
+      if (OSAL_SUCCESS != bus_wait_ready(cfg.programtime))
+        return 0;
+    }
+  }
+
+  return len;
+}
+
+/**
+ *
+ */
+size_t MtdMmap::bus_read(uint8_t *rxbuf, size_t len, uint32_t offset) {
+
+  osalDbgAssert((offset + len) <= capacity(), "Transaction out of device bounds");
+  osalDbgCheck((nullptr != rxbuf) && (0 != len));
+  osalDbgAssert(nullptr != image, "Image not opened");
+  osalDbgAssert(!asleep, "Device in power-down");
+
+  memcpy(rxbuf, &image[offset], len);
+
+  if (nullptr != timing)
+    hostDelayUs(timing_read_us(timing, len));
+
+  return len;
+}
+
+/**
+ * @brief   Sector erase command followed by ready polling.
+ */
+bool MtdMmap::bus_erase_sector(uint32_t offset) {
+
+  osalDbgAssert(0 == (offset % erasesize()), "Unaligned sector");
+  osalDbgAssert((offset + erasesize()) <= capacity(), "Sector out of device bounds");
+  osalDbgAssert(nullptr != image, "Image not opened");
+  osalDbgAssert(!asleep, "Device in power-down");
+
+  memset(&image[offset], 0xFF, erasesize());
+  hostDelayUs(timing_erase_us(timing));
+  busy_until = hostClockNowUs() + timing->erase_typ_us;
+
+  return bus_wait_ready(cfg.erasetime);
+}
+
+/**
+ * @brief   Tracks power state to catch transactions to sleeping device.
+ */
+bool MtdMmap::bus_power(bool on) {
+  asleep = !on;
+  return MtdBase::bus_power(on);
+}
+
+/**
+ * @brief   Burst is SPI feature, I2C driver has single transmit buffer.
+ */
+size_t MtdMmap::burst_max(void) {
+  if (is_fram() && (nullptr != timing) && (MTD_BUS_SPI == timing->bus))
+    return MTD_BUS_WRITE_MAX;
+  else
+    return 0;
+}
+
+/**
+ * @brief   Preamble from write buffer, payload straight from caller.
+ */
+size_t MtdMmap::bus_write_burst(const uint8_t *txdata, size_t len,
+                                uint32_t offset) {
+
+  osalDbgAssert((offset + len) <= capacity(), "Transaction out of device bounds");
+  osalDbgAssert(nullptr != image, "Image not opened");
+  osalDbgAssert(!asleep, "Device in power-down");
+
+  addr2buf(writebuf, offset, cfg.addr_len);
+  memcpy(&image[offset], txdata, len);
+  hostDelayUs(timing_write_us(timing, len));
+
+  return len;
+}
+
+/**
+ * @brief   Emulated ready polling. Every poll charges bus time.
+ */
+bool MtdMmap::bus_wait_ready(systime_t timeout) {
+  uint64_t start;
+
+  if (nullptr == timing)
+    return OSAL_SUCCESS;
+
+  start = hostClockNowUs();
+  while (true) {
+    hostDelayUs(timing_poll_us(timing));
+    if (hostClockNowUs() >= busy_until)
+      return OSAL_SUCCESS;
+    if ((hostClockNowUs() - start) > ST2US(timeout))
+      return OSAL_FAILED;
+  }
+}
+
+/*
+ ******************************************************************************
+ * EXPORTED FUNCTIONS
+ ******************************************************************************
+ */
+
+/**
+ *
+ */
+MtdMmap::MtdMmap(const MtdConfig &cfg, uint8_t *writebuf, size_t writebuf_size,
+                                                        const char *path) :
+MtdBase(cfg, writebuf, writebuf_size),
+path(path),
+fd(-1),
+image(nullptr),
+timing(nullptr),
+busy_until(0),
+asleep(false)
+{
+  return;
+}
+
+/**
+ *
+ */
+MtdMmap::~MtdMmap(void) {
+  close();
+}
+
+/**
+ * @brief   Maps image file. File will be created (filled by 0xFF)
+ *          or resized when needed.
+ */
+bool MtdMmap::open(void) {
+  const size_t size = capacity();
+  off_t oldsize;
+  void *p;
+
+  osalDbgCheck(nullptr == image);
+
+  fd = ::open(path, O_RDWR | O_CREAT, 0644);
+  if (fd < 0)
+    return OSAL_FAILED;
+
+  oldsize = lseek(fd, 0, SEEK_END);
+  if (oldsize < 0)
+    goto FAILED;
+  if (0 != ftruncate(fd, size))
+    goto FAILED;
+
+  p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (MAP_FAILED == p)
+    goto FAILED;
+  image = static_cast<uint8_t *>(p);
+
+  /* virgin chip contains 0xFF */
+  if ((size_t)oldsize < size)
+    memset(&image[oldsize], 0xFF, size - oldsize);
+
+  return OSAL_SUCCESS;
+
+FAILED:
+  ::close(fd);
+  fd = -1;
+  return OSAL_FAILED;
+}
+
+/**
+ *
+ */
+void MtdMmap::close(void) {
+  if (nullptr != image) {
+    msync(image, capacity(), MS_SYNC);
+    munmap(image, capacity());
+    image = nullptr;
+  }
+  if (fd >= 0) {
+    ::close(fd);
+    fd = -1;
+  }
+}
+
+/**
+ * @brief   Erase sector of attached timing model, devices without
+ *          timing have no erase command.
+ */
+uint32_t MtdMmap::erasesize(void) {
+  if (nullptr != timing)
+    return timing->erasesize;
+  else
+    return 0;
+}
+
+/**
+ * @brief   Attach timing model. Set to nullptr to run at memcpy speed.
+ */
+void MtdMmap::set_timing(const MtdTiming *timing) {
+  this->timing = timing;
+}
+
+} /* namespace */
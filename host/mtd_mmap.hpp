@@ -0,0 +1,72 @@
+/*
+    Abstraction layer for EEPROM ICs.
+
+    Copyright (C) 2012..2016 Uladzimir Pylinski aka barthess
+
+    This file is part of 24AA lib.
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#ifndef MTD_MMAP_HPP_
+#define MTD_MMAP_HPP_
+
+#include "ch.hpp"
+#include "hal.h"
+
+#include "mtd_conf.h"
+#include "mtd_base.hpp"
+#include "mtd_timing.hpp"
+
+namespace nvram {
+
+/**
+ * @brief   Memory device emulated by memory mapped image file.
+ * @details Behaves like I2C EEPROM/FRAM: every transaction must fit
+ *          into single page and into write buffer together with address.
+ *          With timing model attached every transaction charges clock
+ *          and page program keeps device busy like real driver sees it:
+ *          sleep for operational program time, then ready polling.
+ *          FRAM on SPI bus accepts burst writes like Mtd25aa does.
+ *          Model with erase sector (SPI NOR) accepts sector erase
+ *          commands, erase keeps device busy the same way as program.
+ */
+class MtdMmap : public MtdBase {
+public:
+  MtdMmap(const MtdConfig &cfg, uint8_t *writebuf, size_t writebuf_size,
+                                                   const char *path);
+  ~MtdMmap(void);
+  bool open(void);
+  void close(void);
+  void set_timing(const MtdTiming *timing);
+  uint32_t erasesize(void);
+protected:
+  size_t bus_write(const uint8_t *txdata, size_t len, uint32_t offset);
+  size_t bus_read(uint8_t *rxbuf, size_t len, uint32_t offset);
+  bool bus_wait_ready(systime_t timeout);
+  bool bus_erase_sector(uint32_t offset);
+  bool bus_power(bool on);
+  size_t burst_max(void);
+  size_t bus_write_burst(const uint8_t *txdata, size_t len, uint32_t offset);
+private:
+  const char *path;
+  int fd;
+  uint8_t *image;
+  const MtdTiming *timing;
+  uint64_t busy_until; /* end of internal program cycle, uS */
+  bool asleep; /* transaction in power-down is a driver bug */
+};
+
+} /* namespace */
+
+#endif /* MTD_MMAP_HPP_ */
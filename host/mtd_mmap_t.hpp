@@ -0,0 +1,66 @@
+/*
+    Abstraction layer for EEPROM ICs.
+
+    Copyright (C) 2012..2016 Uladzimir Pylinski aka barthess
+
+    This file is part of 24AA lib.
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#ifndef MTD_MMAP_T_HPP_
+#define MTD_MMAP_T_HPP_
+
+#include <cstring>
+
+#include "mtd_base_t.hpp"
+
+namespace nvram {
+
+/**
+ * @brief   Compile time specialized counterpart of MtdMmap working
+ *          on caller supplied RAM image. No timing model.
+ */
+template <uint32_t PageSize, uint32_t Pages, size_t AddrLen,
+          size_t Payload = PageSize>
+class MtdMmapT : public MtdBaseT<MtdMmapT<PageSize, Pages, AddrLen, Payload>,
+                                 PageSize, Pages, AddrLen, Payload> {
+  typedef MtdBaseT<MtdMmapT, PageSize, Pages, AddrLen, Payload> Base;
+  friend Base;
+public:
+  MtdMmapT(uint8_t *image) : image(image) {
+    return;
+  }
+
+protected:
+  size_t bus_write(const uint8_t *txdata, size_t len, uint32_t offset) {
+    /* emulate real bus transaction: preamble followed by payload */
+    Base::addr2buf(writebuf, offset);
+    memcpy(&writebuf[AddrLen], txdata, len);
+    memcpy(&image[offset], &writebuf[AddrLen], len);
+    return len;
+  }
+
+  size_t bus_read(uint8_t *rxbuf, size_t len, uint32_t offset) {
+    memcpy(rxbuf, &image[offset], len);
+    return len;
+  }
+
+private:
+  uint8_t *image;
+  uint8_t writebuf[AddrLen + Payload];
+};
+
+} /* namespace */
+
+#endif /* MTD_MMAP_T_HPP_ */
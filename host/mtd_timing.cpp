@@ -0,0 +1,231 @@
+/*
+    Abstraction layer for EEPROM ICs.
+
+    Copyright (C) 2012..2016 Uladzimir Pylinski aka barthess
+
+    This file is part of 24AA lib.
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include <cstring>
+
+#include "mtd_timing.hpp"
+
+namespace nvram {
+
+/*
+ ******************************************************************************
+ * DEFINES
+ ******************************************************************************
+ */
+
+/* I2C sends 8 data bits plus ACK per byte */
+#define I2C_BITS_PER_BYTE     9
+/* START and STOP conditions, about one bit time each */
+#define I2C_FRAME_BITS        2
+/* SPI chip select setup and hold, in bit times */
+#define SPI_FRAME_BITS        2
+
+/*
+ ******************************************************************************
+ * EXTERNS
+ ******************************************************************************
+ */
+
+/*
+ ******************************************************************************
+ * PROTOTYPES
+ ******************************************************************************
+ */
+
+/*
+ ******************************************************************************
+ * GLOBAL VARIABLES
+ ******************************************************************************
+ */
+
+/**
+ * @brief   Microchip 24AA512, 400 kHz I2C, 5 ms write cycle.
+ */
+const MtdTiming timing_24aa512 = {
+    "24aa512", MTD_BUS_I2C, 400000,
+    512, 128, 2, 0,
+    5000, 3000, 0, 0, 0, 0
+};
+
+/**
+ * @brief   Microchip 25AA640A, 10 MHz SPI, 5 ms write cycle.
+ */
+const MtdTiming timing_25aa640 = {
+    "25aa640", MTD_BUS_SPI, 10000000,
+    256, 32, 2, 1,
+    5000, 3500, 0, 0, 0, 0
+};
+
+/**
+ * @brief   Cypress FM24CL64B, 1 MHz I2C, no write delay.
+ */
+const MtdTiming timing_fm24cl64 = {
+    "fm24cl64", MTD_BUS_I2C, 1000000,
+    1, 8192, 2, 0,
+    0, 0, 0, 0, 0, 0
+};
+
+/**
+ * @brief   Cypress FM25V02A, 20 MHz SPI, no write delay.
+ */
+const MtdTiming timing_fm25v02 = {
+    "fm25v02", MTD_BUS_SPI, 20000000,
+    1, 32768, 2, 1,
+    0, 0, 0, 0, 0, 0
+};
+
+/**
+ * @brief   Cypress S25FL512S, 50 MHz SPI, 512 byte page, 256 kB
+ *          sector erase, polled WIP.
+ */
+const MtdTiming timing_s25fl512 = {
+    "s25fl512", MTD_BUS_SPI, 50000000,
+    131072, 512, 4, 1,
+    750, 340, 256 * 1024, 2600000, 520000, 50
+};
+
+static const MtdTiming *presets[] = {
+    &timing_24aa512,
+    &timing_25aa640,
+    &timing_fm24cl64,
+    &timing_fm25v02,
+    &timing_s25fl512,
+};
+
+/*
+ ******************************************************************************
+ ******************************************************************************
+ * LOCAL FUNCTIONS
+ ******************************************************************************
+ ******************************************************************************
+ */
+
+/**
+ * @brief   Time of bus frame carrying given number of bytes.
+ */
+static uint64_t frame_us(const MtdTiming *t, size_t bytes) {
+  uint64_t bits;
+
+  if (MTD_BUS_I2C == t->bus)
+    bits = bytes * I2C_BITS_PER_BYTE + I2C_FRAME_BITS;
+  else
+    bits = bytes * 8 + SPI_FRAME_BITS;
+
+  return (bits * 1000000 + t->bus_clk - 1) / t->bus_clk;
+}
+
+
+/*
+ ******************************************************************************
+ * EXPORTED FUNCTIONS
+ ******************************************************************************
+ */
+
+/**
+ *
+ */
+const MtdTiming *timing_find(const char *name) {
+  for (size_t i=0; i<sizeof(presets)/sizeof(presets[0]); i++) {
+    if (0 == strcmp(name, presets[i]->name))
+      return presets[i];
+  }
+  return nullptr;
+}
+
+/**
+ * @brief   Fills MTD config matching preset.
+ * @note    Driver sleeps worst case program time after every page.
+ */
+void timing_config(const MtdTiming *t, MtdConfig *cfg) {
+  memset(cfg, 0, sizeof(*cfg));
+  cfg->programtime = US2ST(t->program_us);
+  cfg->erasetime   = US2ST(t->erase_us);
+  cfg->pages       = t->pages;
+  cfg->pagesize    = t->pagesize;
+  cfg->addr_len    = t->addr_len;
+  cfg->bus_clk     = t->bus_clk;
+}
+
+/**
+ * @brief   Write buffer fitting whole page with preamble.
+ */
+size_t timing_workbuf_size(const MtdTiming *t) {
+  size_t ret = MTD_WRITE_BUF_SIZE;
+
+  if ((t->pages > 1) && (ret < t->pagesize + t->cmd_len + t->addr_len))
+    ret = t->pagesize + t->cmd_len + t->addr_len;
+
+  return ret;
+}
+
+/**
+ * @brief   Cost of single bus write (fitted in one page) in uS.
+ * @note    Only bus transfer, device becomes busy after it.
+ */
+uint64_t timing_write_us(const MtdTiming *t, size_t len) {
+  /* I2C: device address, memory address, data */
+  size_t bytes = 1 + t->addr_len + len;
+  uint64_t ret;
+
+  if (MTD_BUS_SPI == t->bus) {
+    bytes = t->cmd_len + t->addr_len + len;
+    ret = frame_us(t, 1); /* WREN is separate frame */
+  }
+  else {
+    ret = 0;
+  }
+
+  ret += frame_us(t, bytes);
+  return ret;
+}
+
+/**
+ * @brief   Cost of single ready poll including pause after it in uS.
+ */
+uint64_t timing_poll_us(const MtdTiming *t) {
+  if (MTD_BUS_I2C == t->bus)
+    return t->poll_us + frame_us(t, 1 + t->addr_len); /* ACK poll by dummy address write */
+  else
+    return t->poll_us + frame_us(t, 2); /* RDSR command and status byte */
+}
+
+/**
+ * @brief   Cost of single bus read in uS.
+ */
+uint64_t timing_read_us(const MtdTiming *t, size_t len) {
+  if (MTD_BUS_I2C == t->bus) {
+    /* address write, repeated start, device address, data */
+    return frame_us(t, 1 + t->addr_len) + frame_us(t, 1 + len);
+  }
+  else {
+    return frame_us(t, t->cmd_len + t->addr_len + len);
+  }
+}
+
+/**
+ * @brief   Cost of sector erase command in uS.
+ * @note    Only bus transfer, device becomes busy after it.
+ */
+uint64_t timing_erase_us(const MtdTiming *t) {
+  /* WREN is separate frame, then SE command with address */
+  return frame_us(t, 1) + frame_us(t, t->cmd_len + t->addr_len);
+}
+
+} /* namespace */
@@ -0,0 +1,111 @@
+/*
+    Abstraction layer for EEPROM ICs.
+
+    Copyright (C) 2012..2016 Uladzimir Pylinski aka barthess
+
+    This file is part of 24AA lib.
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#ifndef MTD_TIMING_HPP_
+#define MTD_TIMING_HPP_
+
+#include "ch.hpp"
+#include "hal.h"
+
+#include "mtd_base.hpp"
+
+namespace nvram {
+
+/**
+ *
+ */
+enum mtd_bus_t {
+  MTD_BUS_I2C,
+  MTD_BUS_SPI,
+};
+
+/**
+ * @brief   Timing model of real memory IC and its driver.
+ * @details Used by simulated devices to charge virtual clock.
+ * @note    Costs are datasheet figures and bus arithmetic, they are
+ *          not calibrated against real hardware.
+ */
+struct MtdTiming {
+  /**
+   * @brief   Preset name.
+   */
+  const char    *name;
+  mtd_bus_t     bus;
+  /**
+   * @brief   Bus clock in Hz.
+   */
+  uint32_t      bus_clk;
+  /**
+   * @brief   Geometry. Same meaning as in MtdConfig.
+   */
+  uint32_t      pages;
+  uint32_t      pagesize;
+  size_t        addr_len;
+  /**
+   * @brief   Command bytes preceding address (SPI only).
+   */
+  size_t        cmd_len;
+  /**
+   * @brief   Worst case page program time in uS (datasheet maximum).
+   *          Set it to 0 for FRAM.
+   */
+  uint32_t      program_us;
+  /**
+   * @brief   Program time of simulated specimen in uS. Real parts are
+   *          usually faster than datasheet maximum.
+   */
+  uint32_t      program_typ_us;
+  /**
+   * @brief   Size of sector erased by single command. Set it to 0 for
+   *          devices without erase command.
+   */
+  uint32_t      erasesize;
+  /**
+   * @brief   Worst case sector erase time in uS (datasheet maximum).
+   */
+  uint32_t      erase_us;
+  /**
+   * @brief   Sector erase time of simulated specimen in uS.
+   */
+  uint32_t      erase_typ_us;
+  /**
+   * @brief   Pause between ready polls (ACK poll for I2C, WIP poll
+   *          for SPI) in uS. Set it to 0 for back to back polling.
+   */
+  uint32_t      poll_us;
+};
+
+extern const MtdTiming timing_24aa512;
+extern const MtdTiming timing_25aa640;
+extern const MtdTiming timing_fm24cl64;
+extern const MtdTiming timing_fm25v02;
+extern const MtdTiming timing_s25fl512;
+
+const MtdTiming *timing_find(const char *name);
+void timing_config(const MtdTiming *t, MtdConfig *cfg);
+size_t timing_workbuf_size(const MtdTiming *t);
+uint64_t timing_write_us(const MtdTiming *t, size_t len);
+uint64_t timing_read_us(const MtdTiming *t, size_t len);
+uint64_t timing_poll_us(const MtdTiming *t);
+uint64_t timing_erase_us(const MtdTiming *t);
+
+} /* namespace */
+
+#endif /* MTD_TIMING_HPP_ */
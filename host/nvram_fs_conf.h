@@ -0,0 +1,36 @@
+/*
+    Abstraction layer for EEPROM ICs.
+
+    Copyright (C) 2012..2016 Uladzimir Pylinski aka barthess
+
+    This file is part of 24AA lib.
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#ifndef NVRAM_FS_CONF_H_
+#define NVRAM_FS_CONF_H_
+
+#if !defined(NVRAM_FS_MAX_FILE_NAME_LEN)
+#define NVRAM_FS_MAX_FILE_NAME_LEN        8
+#endif
+
+#if !defined(NVRAM_FS_MAX_FILE_CNT)
+#define NVRAM_FS_MAX_FILE_CNT             3
+#endif
+
+#if !defined(NVRAM_FILE_CACHE_SIZE)
+#define NVRAM_FILE_CACHE_SIZE             32
+#endif
+
+#endif /* NVRAM_FS_CONF_H_ */
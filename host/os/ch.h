@@ -0,0 +1,118 @@
+/*
+    Abstraction layer for EEPROM ICs.
+
+    Copyright (C) 2012..2016 Uladzimir Pylinski aka barthess
+
+    This file is part of 24AA lib.
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/*
+ * Minimal subset of ChibiOS/RT kernel API needed to build the library
+ * on a POSIX host. Only the calls used in 'src' directory are provided.
+ */
+
+#ifndef CH_H_
+#define CH_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#if !defined(FALSE)
+#define FALSE                               0
+#endif
+
+#if !defined(TRUE)
+#define TRUE                                1
+#endif
+
+#if !defined(CH_CFG_ST_FREQUENCY)
+#define CH_CFG_ST_FREQUENCY                 1000000
+#endif
+#define CH_CFG_USE_MUTEXES                  TRUE
+#define CH_CFG_USE_SEMAPHORES               TRUE
+#if !defined(CH_DBG_ENABLE_CHECKS)
+#define CH_DBG_ENABLE_CHECKS                TRUE
+#endif
+#if !defined(CH_DBG_ENABLE_ASSERTS)
+#define CH_DBG_ENABLE_ASSERTS               TRUE
+#endif
+
+#define MSG_OK                              (msg_t)0
+#define MSG_TIMEOUT                         (msg_t)-1
+#define MSG_RESET                           (msg_t)-2
+
+#define NORMALPRIO                          128
+
+typedef uint32_t    systime_t;
+typedef int32_t     msg_t;
+typedef uint32_t    tprio_t;
+typedef struct host_thread thread_t;
+typedef void (*tfunc_t)(void *p);
+
+#define THD_WORKING_AREA(s, n)  uint64_t s[((n) + 7) / 8]
+#define THD_FUNCTION(tname, arg) void tname(void *arg)
+
+#if defined(HOST_CH_TIME_MATH32)
+/* Target flavour: 32-bit intermediate products as in ChibiOS on Cortex-M,
+   used to catch code converting absolute system time */
+#define S2ST(sec)   ((systime_t)((uint32_t)(sec) * (uint32_t)CH_CFG_ST_FREQUENCY))
+#define MS2ST(msec) ((systime_t)(((uint32_t)(msec) *                       \
+                                  (uint32_t)CH_CFG_ST_FREQUENCY + 999U) / 1000U))
+#define US2ST(usec) ((systime_t)(((uint32_t)(usec) *                       \
+                                  (uint32_t)CH_CFG_ST_FREQUENCY + 999999U) / 1000000U))
+#define ST2MS(n)    (((uint32_t)(n) * 1000U + (uint32_t)CH_CFG_ST_FREQUENCY - 1U) / \
+                     (uint32_t)CH_CFG_ST_FREQUENCY)
+#define ST2US(n)    (((uint32_t)(n) * 1000000U + (uint32_t)CH_CFG_ST_FREQUENCY - 1U) / \
+                     (uint32_t)CH_CFG_ST_FREQUENCY)
+#else
+/* 64-bit math: 1 MHz tick overflows 32-bit intermediate products */
+#define S2ST(sec)   ((systime_t)((uint64_t)(sec) * CH_CFG_ST_FREQUENCY))
+#define MS2ST(msec) ((systime_t)(((uint64_t)(msec) *                       \
+                                  CH_CFG_ST_FREQUENCY + 999ULL) / 1000ULL))
+#define US2ST(usec) ((systime_t)(((uint64_t)(usec) *                       \
+                                  CH_CFG_ST_FREQUENCY + 999999ULL) / 1000000ULL))
+#define ST2MS(n)    (((uint64_t)(n) * 1000ULL + CH_CFG_ST_FREQUENCY - 1ULL) / \
+                     CH_CFG_ST_FREQUENCY)
+#define ST2US(n)    (((uint64_t)(n) * 1000000ULL + CH_CFG_ST_FREQUENCY - 1ULL) / \
+                     CH_CFG_ST_FREQUENCY)
+#endif /* HOST_CH_TIME_MATH32 */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  systime_t chVTGetSystemTimeX(void);
+  bool chVTIsSystemTimeWithinX(systime_t start, systime_t end);
+  void chSysPolledDelayX(uint32_t cycles);
+  void chThdSleep(systime_t time);
+  void chSysHalt(const char *reason);
+  void chSysLock(void);
+  void chSysUnlock(void);
+  thread_t *chThdGetSelfX(void);
+  thread_t *chThdCreateStatic(void *wsp, size_t size,
+                              tprio_t prio, tfunc_t pf, void *arg);
+  /* host only: virtual clock for simulated devices */
+  void hostClockSetVirtual(bool enable);
+  bool hostClockIsVirtual(void);
+  uint64_t hostClockNowUs(void);
+  void hostDelayUs(uint64_t us);
+#ifdef __cplusplus
+}
+#endif
+
+#define chThdSleepMilliseconds(msec)        chThdSleep(MS2ST(msec))
+#define chThdSleepMicroseconds(usec)        chThdSleep(US2ST(usec))
+
+#endif /* CH_H_ */
@@ -0,0 +1,105 @@
+/*
+    Abstraction layer for EEPROM ICs.
+
+    Copyright (C) 2012..2016 Uladzimir Pylinski aka barthess
+
+    This file is part of 24AA lib.
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/*
+ * Host replacement of ChibiOS C++ wrapper. Synchronization primitives are
+ * thin wrappers over standard library ones.
+ */
+
+#ifndef CH_HPP_
+#define CH_HPP_
+
+#include <mutex>
+#include <condition_variable>
+
+#include "ch.h"
+
+namespace chibios_rt {
+
+  /**
+   * @brief   System related functionality.
+   */
+  namespace System {
+    void init(void);
+  }
+
+  /**
+   * @brief   Mutex wrapper.
+   * @details Like ChibiOS mutex it passes ownership to the first waiter
+   *          on unlock, so release followed by immediate lock lets
+   *          other threads in. Plain std::mutex does not guarantee it.
+   */
+  class Mutex {
+  public:
+    void lock(void) {
+      std::unique_lock<std::mutex> lk(mtx);
+      const uint32_t ticket = next++;
+      cv.wait(lk, [this, ticket]{return ticket == owner;});
+    }
+    void unlock(void) {
+      std::lock_guard<std::mutex> lk(mtx);
+      owner++;
+      cv.notify_all();
+    }
+  private:
+    std::mutex mtx;
+    std::condition_variable cv;
+    uint32_t next = 0;
+    uint32_t owner = 0;
+  };
+
+  /**
+   * @brief   Counting semaphore wrapper.
+   */
+  class CounterSemaphore {
+  public:
+    CounterSemaphore(int32_t n) : cnt(n) {
+      return;
+    }
+    msg_t wait(void) {
+      std::unique_lock<std::mutex> lk(mtx);
+      cv.wait(lk, [this]{return cnt > 0;});
+      cnt--;
+      return MSG_OK;
+    }
+    void signal(void) {
+      std::lock_guard<std::mutex> lk(mtx);
+      cnt++;
+      cv.notify_one();
+    }
+  private:
+    std::mutex mtx;
+    std::condition_variable cv;
+    int32_t cnt;
+  };
+
+  /**
+   * @brief   Interface of a ChibiOS/RT sequential stream.
+   */
+  class BaseSequentialStreamInterface {
+  public:
+    virtual size_t write(const uint8_t *bp, size_t n) = 0;
+    virtual size_t read(uint8_t *bp, size_t n) = 0;
+    virtual msg_t put(uint8_t b) = 0;
+    virtual msg_t get(void) = 0;
+  };
+}
+
+#endif /* CH_HPP_ */
@@ -0,0 +1,278 @@
+/*
+    Abstraction layer for EEPROM ICs.
+
+    Copyright (C) 2012..2016 Uladzimir Pylinski aka barthess
+
+    This file is part of 24AA lib.
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+#include "ch.hpp"
+#include "hal.h"
+#include "chprintf.h"
+
+/*
+ ******************************************************************************
+ * DEFINES
+ ******************************************************************************
+ */
+
+/*
+ ******************************************************************************
+ * EXTERNS
+ ******************************************************************************
+ */
+
+/*
+ ******************************************************************************
+ * PROTOTYPES
+ ******************************************************************************
+ */
+
+/*
+ ******************************************************************************
+ * GLOBAL VARIABLES
+ ******************************************************************************
+ */
+
+static const std::chrono::steady_clock::time_point boot =
+    std::chrono::steady_clock::now();
+
+/**
+ * @brief   Virtual clock. It moves only when somebody waits.
+ */
+static std::atomic<bool> virtual_mode(false);
+static std::atomic<uint64_t> virtual_us(0);
+
+/**
+ * @brief   Stands for disabled interrupts.
+ */
+static std::mutex kernel_lock;
+
+/*
+ ******************************************************************************
+ ******************************************************************************
+ * LOCAL FUNCTIONS
+ ******************************************************************************
+ ******************************************************************************
+ */
+
+/**
+ *
+ */
+static size_t stdout_write(void *ip, const uint8_t *bp, size_t n) {
+  (void)ip;
+  return fwrite(bp, 1, n, stdout);
+}
+
+/**
+ *
+ */
+static size_t stdout_read(void *ip, uint8_t *bp, size_t n) {
+  (void)ip;
+  return fread(bp, 1, n, stdin);
+}
+
+/**
+ *
+ */
+static msg_t stdout_put(void *ip, uint8_t b) {
+  (void)ip;
+  return (EOF == fputc(b, stdout)) ? MSG_RESET : MSG_OK;
+}
+
+/**
+ *
+ */
+static msg_t stdout_get(void *ip) {
+  (void)ip;
+  int c = fgetc(stdin);
+  return (EOF == c) ? MSG_RESET : c;
+}
+
+static const struct BaseSequentialStreamVMT stdout_vmt = {
+    stdout_write,
+    stdout_read,
+    stdout_put,
+    stdout_get
+};
+
+static BaseSequentialStream stdout_stream = {&stdout_vmt};
+
+/*
+ ******************************************************************************
+ * EXPORTED FUNCTIONS
+ ******************************************************************************
+ */
+
+/**
+ *
+ */
+void chibios_rt::System::init(void) {
+  return;
+}
+
+/**
+ * @brief   Returns system time in ticks since process start.
+ */
+systime_t chVTGetSystemTimeX(void) {
+  return (systime_t)((hostClockNowUs() * CH_CFG_ST_FREQUENCY) / 1000000);
+}
+
+/**
+ *
+ */
+bool chVTIsSystemTimeWithinX(systime_t start, systime_t end) {
+  systime_t now = chVTGetSystemTimeX();
+  return (systime_t)(now - start) < (systime_t)(end - start);
+}
+
+/**
+ *
+ */
+void chSysPolledDelayX(uint32_t cycles) {
+  (void)cycles;
+}
+
+/**
+ *
+ */
+void chThdSleep(systime_t time) {
+  /* own conversion, ST2US() may be built with 32-bit math */
+  hostDelayUs(((uint64_t)time * 1000000ULL + CH_CFG_ST_FREQUENCY - 1ULL) /
+              CH_CFG_ST_FREQUENCY);
+}
+
+/**
+ * @brief   Switch between wall clock and virtual clock.
+ * @note    Virtual clock assumes single thread doing timed work.
+ */
+void hostClockSetVirtual(bool enable) {
+  virtual_us = hostClockNowUs();
+  virtual_mode = enable;
+}
+
+/**
+ *
+ */
+bool hostClockIsVirtual(void) {
+  return virtual_mode;
+}
+
+/**
+ * @brief   Microseconds since process start (wall or virtual).
+ */
+uint64_t hostClockNowUs(void) {
+  using namespace std::chrono;
+
+  if (virtual_mode)
+    return virtual_us;
+  else
+    return duration_cast<microseconds>(steady_clock::now() - boot).count();
+}
+
+/**
+ * @brief   Advances virtual clock or really sleeps.
+ */
+void hostDelayUs(uint64_t us) {
+  if (virtual_mode)
+    virtual_us += us;
+  else
+    std::this_thread::sleep_for(std::chrono::microseconds(us));
+}
+
+/**
+ * @brief   Unique per thread address used as thread identifier.
+ */
+thread_t *chThdGetSelfX(void) {
+  static thread_local char self;
+  return reinterpret_cast<thread_t *>(&self);
+}
+
+/**
+ * @brief   Working area is ignored, thread runs detached until exit.
+ */
+thread_t *chThdCreateStatic(void *wsp, size_t size,
+                            tprio_t prio, tfunc_t pf, void *arg) {
+  (void)wsp;
+  (void)size;
+  (void)prio;
+  std::thread(pf, arg).detach();
+  return nullptr;
+}
+
+/**
+ *
+ */
+void chSysLock(void) {
+  kernel_lock.lock();
+}
+
+/**
+ *
+ */
+void chSysUnlock(void) {
+  kernel_lock.unlock();
+}
+
+/**
+ *
+ */
+void chSysHalt(const char *reason) {
+  fprintf(stderr, "System halted: %s\n", reason);
+  fflush(stdout);
+  abort();
+}
+
+/**
+ *
+ */
+int chvprintf(BaseSequentialStream *chp, const char *fmt, va_list ap) {
+  char buf[256];
+  int n = vsnprintf(buf, sizeof(buf), fmt, ap);
+  if (n < 0)
+    return n;
+  if ((size_t)n >= sizeof(buf))
+    n = sizeof(buf) - 1;
+  streamWrite(chp, (const uint8_t *)buf, n);
+  return n;
+}
+
+/**
+ *
+ */
+int chprintf(BaseSequentialStream *chp, const char *fmt, ...) {
+  va_list ap;
+  int ret;
+
+  va_start(ap, fmt);
+  ret = chvprintf(chp, fmt, ap);
+  va_end(ap);
+  return ret;
+}
+
+/**
+ * @brief   Stream attached to process standard output.
+ */
+BaseSequentialStream *hostStdout(void) {
+  return &stdout_stream;
+}
@@ -0,0 +1,38 @@
+/*
+    Abstraction layer for EEPROM ICs.
+
+    Copyright (C) 2012..2016 Uladzimir Pylinski aka barthess
+
+    This file is part of 24AA lib.
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#ifndef CHPRINTF_H_
+#define CHPRINTF_H_
+
+#include <stdarg.h>
+
+#include "hal.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  int chvprintf(BaseSequentialStream *chp, const char *fmt, va_list ap);
+  int chprintf(BaseSequentialStream *chp, const char *fmt, ...);
+  BaseSequentialStream *hostStdout(void);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CHPRINTF_H_ */
@@ -0,0 +1,106 @@
+/*
+    Abstraction layer for EEPROM ICs.
+
+    Copyright (C) 2012..2016 Uladzimir Pylinski aka barthess
+
+    This file is part of 24AA lib.
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/*
+ * Host replacement of ChibiOS HAL. Provides sequential streams, file
+ * related definitions and I2C driver connected to single emulated 24xx
+ * memory. There are no SPI drivers on host.
+ */
+
+#ifndef HAL_H_
+#define HAL_H_
+
+#include "osal.h"
+
+#define STM_OK                              MSG_OK
+#define STM_TIMEOUT                         MSG_TIMEOUT
+#define STM_RESET                           MSG_RESET
+
+#define FILE_OK                             STM_OK
+#define FILE_ERROR                          STM_TIMEOUT
+
+/**
+ * @brief   BaseSequentialStream virtual methods table.
+ */
+struct BaseSequentialStreamVMT {
+  size_t (*write)(void *instance, const uint8_t *bp, size_t n);
+  size_t (*read)(void *instance, uint8_t *bp, size_t n);
+  msg_t (*put)(void *instance, uint8_t b);
+  msg_t (*get)(void *instance);
+};
+
+/**
+ * @brief   Base stream class.
+ */
+typedef struct {
+  const struct BaseSequentialStreamVMT *vmt;
+} BaseSequentialStream;
+
+#define streamWrite(ip, bp, n)  ((ip)->vmt->write(ip, bp, n))
+#define streamRead(ip, bp, n)   ((ip)->vmt->read(ip, bp, n))
+#define streamPut(ip, b)        ((ip)->vmt->put(ip, b))
+#define streamGet(ip)           ((ip)->vmt->get(ip))
+
+/**
+ * @brief   I2C definitions.
+ */
+#define I2C_NO_ERROR                        0x00
+#define I2C_ACK_FAILURE                     0x04
+#define I2C_USE_MUTUAL_EXCLUSION            FALSE
+
+typedef uint16_t i2caddr_t;
+typedef uint32_t i2cflags_t;
+
+/**
+ * @brief   Host I2C driver with emulated 24xx memory on the bus.
+ * @details Memory NACKs its address while page program is in progress,
+ *          page writes wrap around inside page like in real EEPROM.
+ */
+typedef struct {
+  i2caddr_t       addr;
+  uint8_t         *image;
+  uint32_t        capacity;
+  uint32_t        pagesize;
+  size_t          addr_len;
+  uint32_t        clock;        /* bus clock, Hz */
+  uint32_t        program_us;   /* page program time, 0 for FRAM */
+  uint64_t        busy_until;
+  uint32_t        pointer;
+  i2cflags_t      errors;
+  uint32_t        transfers;
+  uint32_t        nacks;
+} I2CDriver;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void hostI2cInit(I2CDriver *i2cp, i2caddr_t addr, uint8_t *image,
+                   uint32_t capacity, uint32_t pagesize, size_t addr_len,
+                   uint32_t clock, uint32_t program_us);
+  msg_t i2cMasterTransmitTimeout(I2CDriver *i2cp, i2caddr_t addr,
+                                 const uint8_t *txbuf, size_t txbytes,
+                                 uint8_t *rxbuf, size_t rxbytes,
+                                 systime_t timeout);
+  i2cflags_t i2cGetErrors(I2CDriver *i2cp);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HAL_H_ */
@@ -0,0 +1,171 @@
+/*
+    Abstraction layer for EEPROM ICs.
+
+    Copyright (C) 2012..2016 Uladzimir Pylinski aka barthess
+
+    This file is part of 24AA lib.
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/*
+ * Host I2C driver. Single emulated 24xx memory is attached to the bus.
+ */
+
+#include <cstring>
+#include <pthread.h>
+
+#include "hal.h"
+
+/*
+ ******************************************************************************
+ * DEFINES
+ ******************************************************************************
+ */
+
+/*
+ ******************************************************************************
+ * EXTERNS
+ ******************************************************************************
+ */
+
+/*
+ ******************************************************************************
+ * PROTOTYPES
+ ******************************************************************************
+ */
+
+/*
+ ******************************************************************************
+ * GLOBAL VARIABLES
+ ******************************************************************************
+ */
+
+/*
+ ******************************************************************************
+ ******************************************************************************
+ * LOCAL FUNCTIONS
+ ******************************************************************************
+ ******************************************************************************
+ */
+
+/**
+ * @brief   Buffer lies on stack of calling thread.
+ * @note    Target DMA may not reach thread stacks (CCM, DTCM), so
+ *          drivers must transmit from their own buffers.
+ */
+static bool on_stack(const void *p) {
+  pthread_attr_t attr;
+  void *base;
+  size_t size;
+
+  if (0 != pthread_getattr_np(pthread_self(), &attr))
+    return false;
+  pthread_attr_getstack(&attr, &base, &size);
+  pthread_attr_destroy(&attr);
+
+  return (p >= base) && (p < static_cast<uint8_t *>(base) + size);
+}
+
+/**
+ * @brief   Bus time of transaction: start, address byte and payload,
+ *          9 clocks per byte plus stop, rounded to 10 bits.
+ */
+static uint64_t transfer_us(const I2CDriver *i2cp, size_t bytes) {
+  return ((bytes + 1) * 10 * 1000000ULL + i2cp->clock - 1) / i2cp->clock;
+}
+
+/**
+ *
+ */
+static uint32_t buf2addr(const uint8_t *buf, size_t addr_len) {
+  uint32_t ret = 0;
+
+  for (size_t i=0; i<addr_len; i++)
+    ret = (ret << 8) | buf[i];
+  return ret;
+}
+
+/*
+ ******************************************************************************
+ * EXPORTED FUNCTIONS
+ ******************************************************************************
+ */
+
+/**
+ *
+ */
+void hostI2cInit(I2CDriver *i2cp, i2caddr_t addr, uint8_t *image,
+                 uint32_t capacity, uint32_t pagesize, size_t addr_len,
+                 uint32_t clock, uint32_t program_us) {
+  memset(i2cp, 0, sizeof(*i2cp));
+  i2cp->addr = addr;
+  i2cp->image = image;
+  i2cp->capacity = capacity;
+  i2cp->pagesize = pagesize;
+  i2cp->addr_len = addr_len;
+  i2cp->clock = clock;
+  i2cp->program_us = program_us;
+}
+
+/**
+ * @brief   Address NACK returns MSG_RESET like ChibiOS driver.
+ */
+msg_t i2cMasterTransmitTimeout(I2CDriver *i2cp, i2caddr_t addr,
+                               const uint8_t *txbuf, size_t txbytes,
+                               uint8_t *rxbuf, size_t rxbytes,
+                               systime_t timeout) {
+  uint32_t page;
+
+  (void)timeout;
+  osalDbgCheck((nullptr != i2cp) && (txbytes >= i2cp->addr_len));
+  osalDbgAssert(!on_stack(txbuf), "I2C transmit buffer on stack");
+
+  i2cp->transfers++;
+  if ((addr != i2cp->addr) || (hostClockNowUs() < i2cp->busy_until)) {
+    hostDelayUs(transfer_us(i2cp, 0));
+    i2cp->nacks++;
+    i2cp->errors = I2C_ACK_FAILURE;
+    return MSG_RESET;
+  }
+
+  hostDelayUs(transfer_us(i2cp, txbytes + rxbytes));
+  i2cp->errors = I2C_NO_ERROR;
+  i2cp->pointer = buf2addr(txbuf, i2cp->addr_len) % i2cp->capacity;
+  txbuf += i2cp->addr_len;
+  txbytes -= i2cp->addr_len;
+
+  if (txbytes > 0) {
+    page = i2cp->pointer - (i2cp->pointer % i2cp->pagesize);
+    for (size_t i=0; i<txbytes; i++) {
+      i2cp->image[i2cp->pointer] = txbuf[i];
+      i2cp->pointer = page + (i2cp->pointer + 1 - page) % i2cp->pagesize;
+    }
+    if (0 != i2cp->program_us)
+      i2cp->busy_until = hostClockNowUs() + i2cp->program_us;
+  }
+
+  for (size_t i=0; i<rxbytes; i++) {
+    rxbuf[i] = i2cp->image[i2cp->pointer];
+    i2cp->pointer = (i2cp->pointer + 1) % i2cp->capacity;
+  }
+
+  return MSG_OK;
+}
+
+/**
+ *
+ */
+i2cflags_t i2cGetErrors(I2CDriver *i2cp) {
+  return i2cp->errors;
+}
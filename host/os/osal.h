@@ -0,0 +1,69 @@
+/*
+    Abstraction layer for EEPROM ICs.
+
+    Copyright (C) 2012..2016 Uladzimir Pylinski aka barthess
+
+    This file is part of 24AA lib.
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/*
+ * Host replacement of ChibiOS OSAL. Debug checks are enabled by default
+ * and any failure terminates the process with diagnostic message.
+ * Define CH_DBG_ENABLE_CHECKS and CH_DBG_ENABLE_ASSERTS as FALSE to
+ * build the code the way release firmware sees it.
+ */
+
+#ifndef OSAL_H_
+#define OSAL_H_
+
+#include "ch.h"
+
+#define OSAL_SUCCESS                        false
+#define OSAL_FAILED                         true
+
+#define osalSysHalt(reason)                 chSysHalt(reason)
+#define osalSysLock()                       chSysLock()
+#define osalSysUnlock()                     chSysUnlock()
+
+/* as in ChibiOS, disabled checks do not evaluate their arguments */
+#if CH_DBG_ENABLE_CHECKS == TRUE
+#define osalDbgCheck(c) do {                                                \
+  if (!(c))                                                                 \
+    chSysHalt(__func__);                                                    \
+} while (false)
+#else
+#define osalDbgCheck(c) do {                                                \
+  (void)sizeof(c);                                                          \
+} while (false)
+#endif
+
+#if CH_DBG_ENABLE_ASSERTS == TRUE
+#define osalDbgAssert(c, remark) do {                                       \
+  if (!(c))                                                                 \
+    chSysHalt(remark);                                                      \
+} while (false)
+#else
+#define osalDbgAssert(c, remark) do {                                       \
+  (void)sizeof(c);                                                          \
+  (void)(remark);                                                           \
+} while (false)
+#endif
+
+#define osalThreadSleep(time)               chThdSleep(time)
+#define osalThreadSleepMilliseconds(msec)   chThdSleepMilliseconds(msec)
+#define osalThreadSleepMicroseconds(usec)   chThdSleepMicroseconds(usec)
+#define osalOsGetSystemTimeX()              chVTGetSystemTimeX()
+
+#endif /* OSAL_H_ */
@@ -0,0 +1,237 @@
+/*
+    Abstraction layer for EEPROM ICs.
+
+    Copyright (C) 2012..2016 Uladzimir Pylinski aka barthess
+
+    This file is part of 24AA lib.
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/*
+ * Smoke test of library built with debug checks and asserts disabled,
+ * as in release firmware. Test suite relies on osalDbgCheck() so it
+ * can not be used here, every result is checked explicitly instead.
+ * Catches work accidentally placed inside debug checks, benchmark
+ * included.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "ch.hpp"
+#include "hal.h"
+
+#include "mtd_mmap.hpp"
+#include "nvram_fs.hpp"
+#include "nvram_file.hpp"
+#include "nvram_bench.hpp"
+
+using namespace nvram;
+
+/*
+ ******************************************************************************
+ * DEFINES
+ ******************************************************************************
+ */
+
+/* 24AA512 geometry */
+#define PAGESIZE              128
+#define PAGES                 512
+#define ADDR_LEN              2
+#define CAPACITY              (PAGESIZE * PAGES)
+
+#define FILE_NAME             "release"
+#define FILE_SIZE             300
+
+/*
+ ******************************************************************************
+ * EXTERNS
+ ******************************************************************************
+ */
+
+/*
+ ******************************************************************************
+ * GLOBAL VARIABLES
+ ******************************************************************************
+ */
+
+static uint8_t image[CAPACITY];
+static uint8_t pattern[FILE_SIZE];
+static uint8_t readback[FILE_SIZE];
+
+/*
+ *******************************************************************************
+ *******************************************************************************
+ * LOCAL FUNCTIONS
+ *******************************************************************************
+ *******************************************************************************
+ */
+
+#define expect(c) do {                                                      \
+  if (!(c)) {                                                               \
+    fprintf(stderr, "%s:%d: '%s' failed\n", __FILE__, __LINE__, #c);        \
+    return EXIT_FAILURE;                                                    \
+  }                                                                         \
+} while (false)
+
+/**
+ * @brief   Flips one byte of file name in TOC so checksum must not match.
+ */
+static bool corrupt_toc(MtdBase &mtd) {
+  const size_t len = strlen(FILE_NAME);
+
+  if (CAPACITY != mtd.read(image, CAPACITY, 0))
+    return OSAL_FAILED;
+
+  for (size_t i=0; i<CAPACITY-len; i++) {
+    if (0 == memcmp(&image[i], FILE_NAME, len)) {
+      image[i] ^= 1;
+      if (1 != mtd.write(&image[i], 1, i))
+        return OSAL_FAILED;
+      return OSAL_SUCCESS;
+    }
+  }
+
+  return OSAL_FAILED;
+}
+
+/**
+ * @brief   Full file system life cycle for single on-device format.
+ */
+static int fs_case(MtdBase &mtd, fs_format_t format) {
+  Fs fs(mtd);
+  File *file;
+
+  expect(OSAL_SUCCESS == fs.mkfs(format));
+  expect(OSAL_SUCCESS == fs.fsck());
+  expect(OSAL_SUCCESS == fs.mount());
+  file = fs.create(FILE_NAME, FILE_SIZE);
+  expect(nullptr != file);
+  expect(FILE_SIZE == file->write(pattern, FILE_SIZE));
+  fs.close(file);
+  expect(OSAL_SUCCESS == fs.umount());
+
+  expect(OSAL_SUCCESS == fs.fsck());
+  expect(OSAL_SUCCESS == fs.mount());
+  file = fs.open(FILE_NAME);
+  expect(nullptr != file);
+  expect(FILE_SIZE == file->getSize());
+  expect(FILE_SIZE == file->read(readback, FILE_SIZE));
+  expect(0 == memcmp(pattern, readback, FILE_SIZE));
+  fs.close(file);
+  expect(OSAL_SUCCESS == fs.umount());
+
+  /* checksum must cover TOC actually stored on device */
+  expect(OSAL_SUCCESS == corrupt_toc(mtd));
+  expect(OSAL_FAILED == fs.fsck());
+  expect(OSAL_FAILED == fs.mount());
+
+  return EXIT_SUCCESS;
+}
+
+/**
+ * @brief   Benchmark must really do what it measures.
+ */
+static int bench_case(MtdBase &mtd) {
+  static uint8_t buf[4 * PAGESIZE];
+  BenchContext bctx;
+  Fs fs(mtd);
+  File *file;
+
+  bctx.mtd     = &mtd;
+  bctx.buf     = buf;
+  bctx.len     = sizeof(buf);
+  bctx.samples = 4;
+  bctx.clock   = nullptr;
+  bctx.chn     = nullptr;
+  expect(OSAL_SUCCESS == Benchmark(&bctx));
+
+  /* file benchmark is the last one, its file must be there */
+  expect(OSAL_SUCCESS == fs.fsck());
+  expect(OSAL_SUCCESS == fs.mount());
+  file = fs.open("bench");
+  expect(nullptr != file);
+  fs.close(file);
+  expect(OSAL_SUCCESS == fs.umount());
+
+  return EXIT_SUCCESS;
+}
+
+/**
+ *
+ */
+static void usage(const char *name) {
+  fprintf(stderr, "Usage: %s IMAGE\n", name);
+}
+
+/**
+ *
+ */
+int main(int argc, char *argv[]) {
+
+  if (2 != argc) {
+    usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  const MtdConfig cfg = {
+      0,
+      0,
+      PAGES,
+      PAGESIZE,
+      ADDR_LEN,
+      400000,
+      nullptr,
+      nullptr,
+      nullptr,
+      nullptr,
+      nullptr,
+      nullptr,
+      nullptr,
+      nullptr,
+      nullptr,
+      nullptr,
+      0,
+      0,
+  };
+  static uint8_t workbuf[PAGESIZE + ADDR_LEN];
+
+  for (size_t i=0; i<FILE_SIZE; i++)
+    pattern[i] = i * 7 + 1;
+
+  chibios_rt::System::init();
+
+  MtdMmap mtd(cfg, workbuf, sizeof(workbuf), argv[1]);
+  if (OSAL_SUCCESS != mtd.open()) {
+    perror(argv[1]);
+    return EXIT_FAILURE;
+  }
+
+  for (size_t f=FS_FORMAT_V0; f<=FS_FORMAT_V2; f++) {
+    if (EXIT_SUCCESS != fs_case(mtd, static_cast<fs_format_t>(f))) {
+      fprintf(stderr, "format %u failed\n", (unsigned)f);
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (EXIT_SUCCESS != bench_case(mtd)) {
+    fprintf(stderr, "benchmark failed\n");
+    return EXIT_FAILURE;
+  }
+
+  mtd.close();
+  printf("release: OK\n");
+  return EXIT_SUCCESS;
+}
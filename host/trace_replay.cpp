@@ -0,0 +1,193 @@
+/*
+    Abstraction layer for EEPROM ICs.
+
+    Copyright (C) 2012..2016 Uladzimir Pylinski aka barthess
+
+    This file is part of 24AA lib.
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/*
+ * Replays trace dumped by MtdBase::trace_dump() against simulated
+ * device. Device time and statistics of different policies (plain
+ * device or RAM shadow with write back) can be compared offline.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "ch.hpp"
+#include "hal.h"
+#include "chprintf.h"
+
+#include "mtd_mmap.hpp"
+#include "mtd_shadow.hpp"
+
+using namespace nvram;
+
+/*
+ ******************************************************************************
+ * DEFINES
+ ******************************************************************************
+ */
+
+/*
+ ******************************************************************************
+ * EXTERNS
+ ******************************************************************************
+ */
+
+/*
+ ******************************************************************************
+ * GLOBAL VARIABLES
+ ******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ *******************************************************************************
+ * LOCAL FUNCTIONS
+ *******************************************************************************
+ *******************************************************************************
+ */
+
+/**
+ *
+ */
+static void usage(const char *name) {
+  fprintf(stderr, "Usage: %s [-s] IMAGE PRESET TRACE\n", name);
+  fprintf(stderr, "  -s replays through RAM shadow in write back mode.\n");
+  fprintf(stderr, "  Pauses between operations are kept from trace.\n");
+}
+
+/**
+ *
+ */
+int main(int argc, char *argv[]) {
+  const char *self = argv[0];
+  bool shadow = false;
+  char line[256];
+
+  if ((argc > 1) && (0 == strcmp("-s", argv[1]))) {
+    shadow = true;
+    argc--;
+    argv++;
+  }
+  if (4 != argc) {
+    usage(self);
+    return EXIT_FAILURE;
+  }
+
+  const MtdTiming *timing = timing_find(argv[2]);
+  if (nullptr == timing) {
+    usage(self);
+    return EXIT_FAILURE;
+  }
+  FILE *in = fopen(argv[3], "r");
+  if (nullptr == in) {
+    perror(argv[3]);
+    return EXIT_FAILURE;
+  }
+
+  MtdConfig cfg;
+  timing_config(timing, &cfg);
+  const size_t capacity = cfg.pages * cfg.pagesize;
+  const size_t workbuf_size = timing_workbuf_size(timing);
+  uint8_t *workbuf = static_cast<uint8_t *>(malloc(workbuf_size));
+  uint8_t *databuf = static_cast<uint8_t *>(malloc(capacity));
+  uint8_t *mirror  = static_cast<uint8_t *>(malloc(capacity));
+  uint8_t *dirtymap = static_cast<uint8_t *>(calloc(capacity, 1));
+  osalDbgCheck((nullptr != workbuf) && (nullptr != databuf)
+            && (nullptr != mirror) && (nullptr != dirtymap));
+  memset(databuf, 0xA5, capacity);
+
+  chibios_rt::System::init();
+
+  MtdMmap dev(cfg, workbuf, workbuf_size, argv[1]);
+  if (OSAL_SUCCESS != dev.open()) {
+    perror(argv[1]);
+    return EXIT_FAILURE;
+  }
+  dev.set_timing(timing);
+  hostClockSetVirtual(true);
+
+  MtdShadow shd(dev, mirror, dirtymap, true);
+  MtdBase *mtd = &dev;
+  if (shadow) {
+    osalDbgCheck(OSAL_SUCCESS == shd.start());
+    mtd = &shd;
+  }
+
+  const uint64_t start = hostClockNowUs();
+  uint64_t busy = 0;
+  uint32_t first = 0;
+  size_t records = 0;
+  size_t skipped = 0;
+
+  while (nullptr != fgets(line, sizeof(line), in)) {
+    mtd_trace_t t;
+    size_t len;
+
+    if (OSAL_SUCCESS != trace_parse(line, &t))
+      continue;
+    if ((0 == t.len) || (t.offset + t.len > capacity)) {
+      skipped++;
+      continue;
+    }
+    if (0 == records)
+      first = t.time;
+
+    /* keep original pause before operation */
+    const uint64_t due = start + (uint32_t)(t.time - first);
+    if (hostClockNowUs() < due)
+      hostDelayUs(due - hostClockNowUs());
+
+    const uint64_t t0 = hostClockNowUs();
+    if (MTD_OP_WRITE == t.op)
+      len = mtd->write(databuf, t.len, t.offset);
+    else if (MTD_OP_ERASE == t.op)
+      len = mtd->erase(t.offset, t.len);
+    else
+      len = mtd->read(databuf, t.len, t.offset);
+    busy += hostClockNowUs() - t0;
+    osalDbgCheck(len == t.len);
+    records++;
+  }
+  fclose(in);
+
+  if (shadow) {
+    const uint64_t t0 = hostClockNowUs();
+    osalDbgCheck(OSAL_SUCCESS == shd.flush());
+    busy += hostClockNowUs() - t0;
+  }
+
+  printf("records=%u skipped=%u total_us=%llu busy_us=%llu\n",
+         (unsigned)records, (unsigned)skipped,
+         (unsigned long long)(hostClockNowUs() - start),
+         (unsigned long long)busy);
+#if MTD_USE_STATS
+  MtdStats st;
+  dev.stats_get(&st);
+  stats_print(hostStdout(), &st);
+#endif
+
+  dev.close();
+  free(workbuf);
+  free(databuf);
+  free(mirror);
+  free(dirtymap);
+
+  return EXIT_SUCCESS;
+}
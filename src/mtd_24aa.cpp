@@ -58,19 +58,6 @@ namespace nvram {
  ******************************************************************************
  ******************************************************************************
  */
-/**
- * @brief     Calculates requred timeout.
- */
-static systime_t calc_timeout(size_t bytes, uint32_t clock) {
-  const uint32_t bitsinbyte = 10;
-  uint32_t tmo_ms;
-
-  tmo_ms = ((bytes + 1) * bitsinbyte * 1000);
-  tmo_ms /= clock;
-  tmo_ms += 10; /* some additional milliseconds to be safer */
-  return MS2ST(tmo_ms);
-}
-
 /**
  *
  */
@@ -84,7 +71,7 @@ msg_t Mtd24aa::i2c_read(uint8_t *rxbuf, size_t len,
 #endif /* defined(STM32F1XX_I2C) */
 
   msg_t status;
-  systime_t tmo = calc_timeout(len + preamble_len, this->bus_clk);
+  systime_t tmo = i2c_calc_timeout(len + preamble_len, this->bus_clk);
   osalDbgCheck((nullptr != rxbuf) && (0 != len));
 
 #if I2C_USE_MUTUAL_EXCLUSION
@@ -116,9 +103,10 @@ msg_t Mtd24aa::i2c_write(const uint8_t *txdata, size_t len,
 #endif /* defined(STM32F1XX_I2C) */
 
   msg_t status;
-  systime_t tmo = calc_timeout(len + preamble_len, this->bus_clk);
+  systime_t tmo = i2c_calc_timeout(len + preamble_len, this->bus_clk);
 
-  if ((nullptr != txdata) && (0 != len))
+  /* data may be already gathered in place by MtdBase::writev() */
+  if ((nullptr != txdata) && (0 != len) && (txdata != &writebuf[preamble_len]))
     memcpy(&writebuf[preamble_len], txdata, len);
 
 #if I2C_USE_MUTUAL_EXCLUSION
@@ -138,13 +126,16 @@ msg_t Mtd24aa::i2c_write(const uint8_t *txdata, size_t len,
 }
 
 /**
- *
+ * @brief   Sleeps operational program time, then ACK polls the rest.
  */
 bool Mtd24aa::wait_op_complete(void) {
-  if (0 != cfg.programtime)
-    osalThreadSleep(cfg.programtime);
+  if (is_fram())
+    return OSAL_SUCCESS;
+
+  if (0 != programtime)
+    osalThreadSleep(programtime);
 
-  return OSAL_SUCCESS;
+  return bus_wait_ready(cfg.programtime);
 }
 
 /*
@@ -174,16 +165,11 @@ size_t Mtd24aa::bus_write(const uint8_t *txdata, size_t len, uint32_t offset) {
   osalDbgCheck((this->writebuf_size - cfg.addr_len) >= len);
   osalDbgAssert((offset + len) <= capacity(), "Transaction out of device bounds");
 
-  this->acquire();
-
   /* write preamble. Only address bytes for this memory type */
   addr2buf(writebuf, offset, cfg.addr_len);
   status = i2c_write(txdata, len, writebuf, cfg.addr_len);
 
-  wait_op_complete();
-  this->release();
-
-  if (status == MSG_OK)
+  if ((status == MSG_OK) && (OSAL_SUCCESS == wait_op_complete()))
     return len;
   else
     return 0;
@@ -198,10 +184,8 @@ size_t Mtd24aa::bus_read(uint8_t *rxbuf, size_t len, uint32_t offset) {
   osalDbgAssert((offset + len) <= capacity(), "Transaction out of device bounds");
   osalDbgCheck(this->writebuf_size >= cfg.addr_len);
 
-  this->acquire();
   addr2buf(writebuf, offset, cfg.addr_len);
   status = i2c_read(rxbuf, len, writebuf, cfg.addr_len);
-  this->release();
 
   if (MSG_OK == status)
     return len;
@@ -209,12 +193,66 @@ size_t Mtd24aa::bus_read(uint8_t *rxbuf, size_t len, uint32_t offset) {
     return 0;
 }
 
+/**
+ * @brief   ACK polling.
+ */
+bool Mtd24aa::bus_wait_ready(systime_t timeout) {
+  return i2c_ack_poll(this->i2cp, this->addr, writebuf, cfg.addr_len,
+                      this->bus_clk, timeout, &this->i2cflags);
+}
+
 /*
  ******************************************************************************
  * EXPORTED FUNCTIONS
  ******************************************************************************
  */
 
+/**
+ * @brief     Calculates requred timeout.
+ */
+systime_t i2c_calc_timeout(size_t bytes, uint32_t clock) {
+  const uint32_t bitsinbyte = 10;
+  uint32_t tmo_ms;
+
+  tmo_ms = ((bytes + 1) * bitsinbyte * 1000);
+  tmo_ms /= clock;
+  tmo_ms += 10; /* some additional milliseconds to be safer */
+  return MS2ST(tmo_ms);
+}
+
+/**
+ * @brief   ACK polling. Busy device does not acknowledge its address.
+ * @note    Dummy address write only moves internal address pointer.
+ *
+ * @param[in] txbuf   any 'addr_len' bytes in DMA reachable memory,
+ *                    driver's write buffer is fine.
+ */
+bool i2c_ack_poll(I2CDriver *i2cp, i2caddr_t addr, const uint8_t *txbuf,
+                  size_t addr_len, uint32_t clock, systime_t timeout,
+                  i2cflags_t *i2cflags) {
+  const systime_t start = osalOsGetSystemTimeX();
+  const systime_t tmo = i2c_calc_timeout(addr_len, clock);
+  msg_t status;
+
+  osalDbgCheck(nullptr != txbuf);
+
+  do {
+#if I2C_USE_MUTUAL_EXCLUSION
+    i2cAcquireBus(i2cp);
+#endif
+    status = i2cMasterTransmitTimeout(i2cp, addr, txbuf, addr_len,
+                                      nullptr, 0, tmo);
+#if I2C_USE_MUTUAL_EXCLUSION
+    i2cReleaseBus(i2cp);
+#endif
+    if (MSG_OK == status)
+      return OSAL_SUCCESS;
+  } while (chVTIsSystemTimeWithinX(start, start + timeout + 1));
+
+  *i2cflags = i2cGetErrors(i2cp);
+  return OSAL_FAILED;
+}
+
 /**
  *
  */
@@ -29,6 +29,11 @@
 
 namespace nvram {
 
+systime_t i2c_calc_timeout(size_t bytes, uint32_t clock);
+bool i2c_ack_poll(I2CDriver *i2cp, i2caddr_t addr, const uint8_t *txbuf,
+                  size_t addr_len, uint32_t clock, systime_t timeout,
+                  i2cflags_t *i2cflags);
+
 /**
  *
  */
@@ -39,6 +44,7 @@ public:
 protected:
   size_t bus_write(const uint8_t *txdata, size_t len, uint32_t offset);
   size_t bus_read(uint8_t *rxbuf, size_t len, uint32_t offset);
+  bool bus_wait_ready(systime_t timeout);
 private:
   bool wait_op_complete(void);
   msg_t i2c_read(uint8_t *rxbuf, size_t len,
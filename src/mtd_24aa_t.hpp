@@ -0,0 +1,128 @@
+/*
+    Abstraction layer for EEPROM ICs.
+
+    Copyright (C) 2012..2016 Uladzimir Pylinski aka barthess
+
+    This file is part of 24AA lib.
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#ifndef MTD_24AA_T_HPP_
+#define MTD_24AA_T_HPP_
+
+#include <cstring>
+
+#include "mtd_base_t.hpp"
+#include "mtd_24aa.hpp"
+
+namespace nvram {
+
+/**
+ * @brief   I2C EEPROM/FRAM driver with compile time geometry.
+ * @details Example: Mtd24aaT<128, 512, 2> for 24AA512,
+ *          Mtd24aaT<8192, 1, 2, 32> for FM24CL64.
+ * @note    Write buffer is member of driver, sized by template. Every
+ *          I2C transmission goes from it, so driver object must be
+ *          placed in DMA reachable memory, not on thread stack.
+ */
+template <uint32_t PageSize, uint32_t Pages, size_t AddrLen,
+          size_t Payload = PageSize>
+class Mtd24aaT : public MtdBaseT<Mtd24aaT<PageSize, Pages, AddrLen, Payload>,
+                                 PageSize, Pages, AddrLen, Payload> {
+  typedef MtdBaseT<Mtd24aaT, PageSize, Pages, AddrLen, Payload> Base;
+  friend Base;
+public:
+  /**
+   * @param[in] programtime   worst case page program time, 0 for FRAM
+   * @param[in] bus_clk       bus clock in Hz for timeout calculation
+   */
+  Mtd24aaT(I2CDriver *i2cp, i2caddr_t addr, systime_t programtime,
+           uint32_t bus_clk) :
+  i2cp(i2cp),
+  addr(addr),
+  programtime(programtime),
+  bus_clk(bus_clk)
+  {
+    return;
+  }
+
+protected:
+  /**
+   * @brief   Accepts data fitted in single page and Payload.
+   * @note    EEPROM completion is waited like in Mtd24aa: program time
+   *          sleep, then ACK polling.
+   */
+  size_t bus_write(const uint8_t *txdata, size_t len, uint32_t offset) {
+    msg_t status;
+
+    Base::addr2buf(writebuf, offset);
+    memcpy(&writebuf[AddrLen], txdata, len);
+
+#if I2C_USE_MUTUAL_EXCLUSION
+    i2cAcquireBus(i2cp);
+#endif
+    status = i2cMasterTransmitTimeout(i2cp, addr, writebuf, AddrLen + len,
+                                      nullptr, 0,
+                                      i2c_calc_timeout(AddrLen + len, bus_clk));
+    if (MSG_OK != status)
+      i2cflags = i2cGetErrors(i2cp);
+#if I2C_USE_MUTUAL_EXCLUSION
+    i2cReleaseBus(i2cp);
+#endif
+
+    if ((MSG_OK == status) && (1 != Pages) && (0 != programtime)) {
+      osalThreadSleep(programtime);
+      if (OSAL_SUCCESS != i2c_ack_poll(i2cp, addr, writebuf, AddrLen,
+                                       bus_clk, programtime, &i2cflags))
+        status = MSG_TIMEOUT;
+    }
+
+    return (MSG_OK == status) ? len : 0;
+  }
+
+  /**
+   * @brief   Address goes from write buffer, as in Mtd24aa.
+   */
+  size_t bus_read(uint8_t *rxbuf, size_t len, uint32_t offset) {
+    msg_t status;
+
+    Base::addr2buf(writebuf, offset);
+
+#if I2C_USE_MUTUAL_EXCLUSION
+    i2cAcquireBus(i2cp);
+#endif
+    status = i2cMasterTransmitTimeout(i2cp, addr, writebuf, AddrLen,
+                                      rxbuf, len,
+                                      i2c_calc_timeout(AddrLen + len, bus_clk));
+    if (MSG_OK != status)
+      i2cflags = i2cGetErrors(i2cp);
+#if I2C_USE_MUTUAL_EXCLUSION
+    i2cReleaseBus(i2cp);
+#endif
+
+    return (MSG_OK == status) ? len : 0;
+  }
+
+private:
+  I2CDriver *i2cp;
+  i2caddr_t addr;
+  i2cflags_t i2cflags = 0;
+  const systime_t programtime;
+  const uint32_t bus_clk;
+  uint8_t writebuf[AddrLen + Payload];
+};
+
+} /* namespace */
+
+#endif /* MTD_24AA_T_HPP_ */
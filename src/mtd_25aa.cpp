@@ -98,7 +98,8 @@ msg_t Mtd25aa::spi_read(uint8_t *rxbuf, size_t len,
 msg_t Mtd25aa::spi_write(const uint8_t *txdata, size_t len,
                          uint8_t *writebuf, size_t preamble_len) {
 
-  if ((nullptr != txdata) && (len > 0)) {
+  /* data may be already gathered in place by MtdBase::writev() */
+  if ((nullptr != txdata) && (len > 0) && (txdata != &writebuf[preamble_len])) {
     memcpy(&writebuf[preamble_len], txdata, len);
   }
 
@@ -124,19 +125,56 @@ msg_t Mtd25aa::spi_write(const uint8_t *txdata, size_t len,
     return MSG_RESET;
 }
 
+/**
+ * @brief   Preamble and payload as two DMA segments under single chip
+ *          select, payload goes straight from caller's buffer.
+ */
+msg_t Mtd25aa::spi_write_burst(const uint8_t *txdata, size_t len,
+                               uint8_t *writebuf, size_t preamble_len) {
+
+  osalDbgCheck((nullptr != txdata) && (0 != len));
+
+#if SPI_USE_MUTUAL_EXCLUSION
+  spiAcquireBus(this->spip);
+#endif
+
+  this->cfg.spi_select();
+  spiPolledExchange(spip, CMD_25AA_WREN);
+  this->cfg.spi_unselect();
+
+  this->cfg.spi_select();
+  spiSend(spip, preamble_len, writebuf);
+  spiSend(spip, len, txdata);
+  this->cfg.spi_unselect();
+
+#if SPI_USE_MUTUAL_EXCLUSION
+  spiReleaseBus(this->spip);
+#endif
+
+  return MSG_OK;
+}
+
 /*
- *
+ * @brief   Sleeps operational program time, then polls the rest.
  */
 bool Mtd25aa::wait_op_complete(void) {
-  uint8_t tmp;
-  bool ret;
-
-  if (0 == cfg.programtime) {
+  if (is_fram())
     return OSAL_SUCCESS;
-  }
-  else {
-    osalThreadSleep(cfg.programtime);
 
+  if (0 != programtime)
+    osalThreadSleep(programtime);
+
+  return bus_wait_ready(cfg.programtime);
+}
+
+/**
+ * @brief   Polls WIP bit of status register.
+ */
+bool Mtd25aa::bus_wait_ready(systime_t timeout) {
+  const systime_t start = osalOsGetSystemTimeX();
+  uint8_t tmp;
+
+  do {
 #if SPI_USE_MUTUAL_EXCLUSION
     spiAcquireBus(this->spip);
 #endif
@@ -146,17 +184,22 @@ bool Mtd25aa::wait_op_complete(void) {
     tmp = spiPolledExchange(spip, 0);
     this->cfg.spi_unselect();
 
-    if (tmp & STATUS_25AA_WIP)
-      ret = OSAL_FAILED;
-    else
-      ret = OSAL_SUCCESS;
-
 #if SPI_USE_MUTUAL_EXCLUSION
     spiReleaseBus(this->spip);
 #endif
-  }
 
-  return ret;
+    if (0 == (tmp & STATUS_25AA_WIP))
+      return OSAL_SUCCESS;
+  } while (chVTIsSystemTimeWithinX(start, start + timeout + 1));
+
+  return OSAL_FAILED;
+}
+
+/**
+ * @brief   Command byte followed by address.
+ */
+size_t Mtd25aa::preamble_len(void) {
+  return 1 + cfg.addr_len;
 }
 
 /**
@@ -166,17 +209,46 @@ bool Mtd25aa::wait_op_complete(void) {
 size_t Mtd25aa::bus_write(const uint8_t *txdata, size_t len, uint32_t offset) {
   msg_t status;
 
-  osalDbgCheck(this->writebuf_size >= cfg.pagesize + cfg.addr_len + 1);
+  osalDbgCheck(this->writebuf_size >= len + cfg.addr_len + 1);
   osalDbgAssert((offset + len) <= capacity(), "Transaction out of device bounds");
 
-  this->acquire();
-
   /* fill preamble */
   writebuf[0] = CMD_25AA_WRITE;
   addr2buf(&writebuf[1], offset, cfg.addr_len);
   status = spi_write(txdata, len, writebuf, 1+cfg.addr_len);
 
-  this->release();
+  if (MSG_OK == status)
+    return len;
+  else
+    return 0;
+}
+
+/**
+ * @brief   FRAM has neither page boundary nor write cycle, so whole
+ *          write goes in one transaction.
+ */
+size_t Mtd25aa::burst_max(void) {
+  if (is_fram())
+    return MTD_BUS_WRITE_MAX;
+  else
+    return 0;
+}
+
+/**
+ * @brief   Write of arbitrary length without copying to write buffer.
+ * @note    txdata must be accessible by SPI DMA.
+ */
+size_t Mtd25aa::bus_write_burst(const uint8_t *txdata, size_t len,
+                                uint32_t offset) {
+  msg_t status;
+
+  osalDbgCheck(this->writebuf_size >= cfg.addr_len + 1);
+  osalDbgAssert((offset + len) <= capacity(), "Transaction out of device bounds");
+
+  /* fill preamble */
+  writebuf[0] = CMD_25AA_WRITE;
+  addr2buf(&writebuf[1], offset, cfg.addr_len);
+  status = spi_write_burst(txdata, len, writebuf, 1+cfg.addr_len);
 
   if (MSG_OK == status)
     return len;
@@ -194,16 +266,12 @@ size_t Mtd25aa::bus_read(uint8_t *rxbuf, size_t len, uint32_t offset) {
   osalDbgCheck(this->writebuf_size >= cfg.addr_len + 1);
   osalDbgCheck((nullptr != rxbuf) && (0 != len));
 
-  this->acquire();
-
   /* fill preamble */
   writebuf[0] = CMD_25AA_READ;
   addr2buf(&writebuf[1], offset, cfg.addr_len);
 
   status = spi_read(rxbuf, len, writebuf, 1+cfg.addr_len);
 
-  this->release();
-
   if (MSG_OK == status)
     return len;
   else
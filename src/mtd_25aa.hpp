@@ -38,6 +38,10 @@ public:
 protected:
   size_t bus_write(const uint8_t *txdata, size_t len, uint32_t offset);
   size_t bus_read(uint8_t *rxbuf, size_t len, uint32_t offset);
+  size_t preamble_len(void);
+  bool bus_wait_ready(systime_t timeout);
+  size_t burst_max(void);
+  size_t bus_write_burst(const uint8_t *txdata, size_t len, uint32_t offset);
 private:
   bool spi_write_enable(void);
   bool wait_op_complete(void);
@@ -45,6 +49,8 @@ private:
                  uint8_t *writebuf, size_t preamble_len);
   msg_t spi_write(const uint8_t *txdata, size_t len,
                   uint8_t *writebuf, size_t preamble_len);
+  msg_t spi_write_burst(const uint8_t *txdata, size_t len,
+                        uint8_t *writebuf, size_t preamble_len);
   SPIDriver *spip;
 };
 
@@ -33,6 +33,19 @@ namespace nvram {
  ******************************************************************************
  */
 
+#define WEAR_MAGIC            0x52414557U /* "WEAR" */
+#define WEAR_SUM_SEED         2166136261U
+
+#if MTD_USE_POWER
+/**
+ * @brief   Record header in deferred write queue, payload follows.
+ */
+struct mtd_defer_hdr_t {
+  uint32_t  offset;
+  uint32_t  len;
+};
+#endif
+
 /*
  ******************************************************************************
  * EXTERNS
@@ -58,6 +71,52 @@ namespace nvram {
  ******************************************************************************
  ******************************************************************************
  */
+#if MTD_USE_WEAR
+/**
+ * @brief   Stream consumer accumulating checksum of counters.
+ */
+static bool wear_sum_cb(const uint8_t *data, size_t len, void *arg) {
+  uint32_t *sum = static_cast<uint32_t *>(arg);
+
+  *sum = wear_checksum(data, len, *sum);
+  return OSAL_SUCCESS;
+}
+#endif /* MTD_USE_WEAR */
+
+/**
+ * @brief   Converts tick interval to uS with 64-bit math.
+ */
+static uint32_t calib_ticks2us(uint64_t ticks) {
+  return (ticks * 1000000ULL + CH_CFG_ST_FREQUENCY - 1) / CH_CFG_ST_FREQUENCY;
+}
+
+/**
+ * @brief   Length of leading part of buffer equal to reference data or,
+ *          when reference is nullptr, to pattern byte.
+ * @details Compares word by word, tail and mismatched word byte by byte.
+ */
+static size_t match_len(const uint8_t *buf, const uint8_t *ref,
+                        uint8_t pattern, size_t len) {
+  const uint32_t pw = 0x01010101U * pattern;
+  size_t i = 0;
+
+  for (; (i + sizeof(uint32_t)) <= len; i += sizeof(uint32_t)) {
+    uint32_t w, r = pw;
+    memcpy(&w, &buf[i], sizeof(w));
+    if (nullptr != ref)
+      memcpy(&r, &ref[i], sizeof(r));
+    if (w != r)
+      break;
+  }
+
+  for (; i < len; i++) {
+    if (buf[i] != ((nullptr != ref) ? ref[i] : pattern))
+      break;
+  }
+
+  return i;
+}
+
 /**
  * @brief   Split multibyte address into uint8_t array.
  *
@@ -93,9 +152,9 @@ void MtdBase::addr2buf(uint8_t *buf, uint32_t addr, size_t addr_len) {
 }
 
 /**
- *
+ * @brief   Takes device lock only.
  */
-void MtdBase::acquire(void) {
+void MtdBase::lock(void) {
 #if MTD_USE_MUTUAL_EXCLUSION
   #if CH_CFG_USE_MUTEXES
     mutex.lock();
@@ -105,6 +164,19 @@ void MtdBase::acquire(void) {
 #endif /* MTD_USE_MUTUAL_EXCLUSION */
 }
 
+/**
+ * @brief   Takes device lock for operation.
+ * @details Deferred writes go to device first: it is going to be busy
+ *          anyway and following operation must see their data.
+ */
+void MtdBase::acquire(void) {
+  this->lock();
+#if MTD_USE_POWER
+  if (0 != defer_used)
+    (void)defer_drain();
+#endif
+}
+
 /**
  *
  */
@@ -119,7 +191,8 @@ void MtdBase::release(void) {
 }
 
 /**
- *
+ * @brief   Single bus write fitted in page and write buffer.
+ * @note    Must be called with lock held.
  */
 size_t MtdBase::fitted_write(const uint8_t *txdata, size_t len, uint32_t offset) {
 
@@ -129,166 +202,1717 @@ size_t MtdBase::fitted_write(const uint8_t *txdata, size_t len, uint32_t offset)
   osalDbgAssert(((offset / cfg.pagesize) == ((offset + len - 1) / cfg.pagesize)),
              "Data can not be fitted in single page");
 
- return bus_write(txdata, len, offset);
+  size_t ret;
+  uint32_t t0;
+
+  t0 = bus_begin(MTD_OP_WRITE, offset, len);
+  ret = bus_write(txdata, len, offset);
+  bus_done(MTD_OP_WRITE, offset, len, ret, t0);
+  wear_account(len, offset);
+  write_yield();
+
+  return ret;
 }
 
 /**
- * @brief   Splits big transaction into smaller ones fitted into MTD's buffer.
+ * @brief   FRAM write sent straight from caller's buffer in transactions
+ *          up to burst_max() bytes, write buffer holds preamble only.
+ * @note    Must be called with lock held.
+ * @return  Number of written bytes.
  */
-size_t MtdBase::split_by_buffer(const uint8_t *txdata, size_t len, uint32_t offset) {
+size_t MtdBase::burst_write(const uint8_t *txdata, size_t len, uint32_t offset) {
+  const size_t max = burst_max();
   size_t written = 0;
-  size_t tmp;
-  const uint32_t blocksize = this->writebuf_size - cfg.addr_len;
-  const uint32_t big_writes = len / blocksize;
-  const uint32_t small_write_size = len % blocksize;
 
-  /* write big blocks */
-  for (size_t i=0; i<big_writes; i++) {
-    tmp = fitted_write(txdata, blocksize, offset);
-    if (blocksize == tmp) {
-      txdata += tmp;
-      offset += tmp;
-      written += tmp;
-    }
-    else
-      goto EXIT;
-  }
+  while (written < len) {
+    size_t L = len - written;
+    size_t got;
+    uint32_t t0;
 
-  /* write tail (if any) */
-  if (small_write_size > 0) {
-    tmp = fitted_write(txdata, small_write_size, offset);
-    if (small_write_size == tmp)
-      written += tmp;
+    if (L > max)
+      L = max;
+
+    t0 = bus_begin(MTD_OP_WRITE, offset + written, L);
+    got = bus_write_burst(&txdata[written], L, offset + written);
+    bus_done(MTD_OP_WRITE, offset + written, L, got, t0);
+    wear_account(L, offset + written);
+    write_yield();
+    if (L != got)
+      break;
+    written += L;
   }
 
-EXIT:
   return written;
 }
 
 /**
- * @brief   Splits big transaction into smaller ones fitted into memory page.
- * @return  Number of written bytes.
+ * @brief   Whether write() needs more than one bus transaction.
  */
-size_t MtdBase::split_by_page(const uint8_t *txdata, size_t len, uint32_t offset) {
+bool MtdBase::write_split(size_t len, uint32_t offset) {
+  if ((1 == cfg.pages) && (0 != burst_max()))
+    return len > burst_max();
+  else
+    return gather_len(len, offset) < len;
+}
 
-  /* bytes to be written at one transaction */
-  size_t L = 0;
-  /* total bytes successfully written */
-  size_t written = 0;
-  size_t status = 0;
-  /* cached value */
-  const uint32_t pagesize = cfg.pagesize;
-  /* first page to be affected during transaction */
-  const uint32_t firstpage = offset / pagesize;
-  /* last page to be affected during transaction */
-  const uint32_t lastpage = (offset + len - 1) / pagesize;
+/**
+ * @brief   Releases and retakes lock every yield_pages bus writes,
+ *          so threads waiting for device are not starved by long write.
+ * @note    Must be called with lock held.
+ */
+void MtdBase::write_yield(void) {
+  if (0 == yield_pages)
+    return;
 
-  /* data fits in single page */
-  if (firstpage == lastpage) {
-    L = len;
-    written = fitted_write(txdata, L, offset);
-    txdata += L;
-    offset += L;
-    goto EXIT;
+  burst++;
+  if (burst >= yield_pages) {
+    burst = 0;
+    this->release();
+    this->acquire();
   }
-  else{
-    /* write first piece of data to the first page boundary */
-    L = firstpage * pagesize + pagesize - offset;
-    status = fitted_write(txdata, L, offset);
-    if (status != L)
-      goto EXIT;
-    else
-      written += status;
-    txdata += L;
-    offset += L;
+}
 
-    /* now writes blocks at a size of pages (may be no one) */
-    L = pagesize;
-    while ((len - written) > pagesize){
-      status = fitted_write(txdata, L, offset);
-      if (status != L)
-        goto EXIT;
-      else
-        written += status;
-      txdata += L;
-      offset += L;
-    }
+/**
+ * @brief   Passes event to profiling hook.
+ */
+void MtdBase::event(mtd_event_type_t type, mtd_op_t op, uint32_t offset,
+                    size_t len, size_t done, uint32_t t0) {
+  mtd_event_t ev;
 
-    /* write tail */
-    L = len - written;
-    if (0 == L)
-      goto EXIT;
-    else{
-      written += fitted_write(txdata, L, offset);
-    }
+  ev.type    = type;
+  ev.op      = op;
+  ev.offset  = offset;
+  ev.len     = len;
+  ev.done    = done;
+  ev.status  = (len == done) ? OSAL_SUCCESS : OSAL_FAILED;
+  ev.t_begin = t0;
+  ev.t_end   = t0;
+  if ((MTD_EVENT_OP_END == type) || (MTD_EVENT_BUS_END == type))
+    ev.t_end = MTD_STATS_TIMESTAMP();
+
+  cfg.hook_event(this, &ev);
+}
+
+/**
+ * @brief   Waits until device finishes internal program/erase cycle.
+ * @details Default for devices without ready status: waits worst case.
+ *          Drivers override it with ACK polling (I2C) or status
+ *          register polling (SPI).
+ *
+ * @return  OSAL_FAILED if device still busy after timeout.
+ */
+bool MtdBase::bus_wait_ready(systime_t timeout) {
+  if (0 != timeout)
+    osalThreadSleep(timeout);
+
+  return OSAL_SUCCESS;
+}
+
+/**
+ * @brief   Erases single sector of erasesize() bytes.
+ * @details Default for devices without erase command, never called
+ *          because their erasesize() is 0.
+ *
+ * @return  OSAL_FAILED on error.
+ */
+bool MtdBase::bus_erase_sector(uint32_t offset) {
+  (void)offset;
+  return OSAL_FAILED;
+}
+
+/**
+ * @brief   Switches device power.
+ * @details Default switches rail by MtdConfig::hook_power and waits
+ *          start-up time after power up. Does nothing without hook.
+ * @note    Called with lock held.
+ *
+ * @return  OSAL_FAILED on error.
+ */
+bool MtdBase::bus_power(bool on) {
+  if (nullptr == cfg.hook_power)
+    return OSAL_SUCCESS;
+
+  cfg.hook_power(this, on);
+  if (on && (0 != cfg.wakeuptime))
+    osalThreadSleep(cfg.wakeuptime);
+
+  return OSAL_SUCCESS;
+}
+
+/**
+ * @brief   Sends preamble from write buffer and payload from txdata
+ *          as one transaction.
+ * @details Default for drivers without burst support, never called
+ *          because their burst_max() is 0.
+ *
+ * @return  Number of written bytes.
+ */
+size_t MtdBase::bus_write_burst(const uint8_t *txdata, size_t len,
+                                uint32_t offset) {
+  (void)txdata;
+  (void)len;
+  (void)offset;
+  return 0;
+}
+
+/**
+ * @brief   Marks start of single bus transaction.
+ * @note    Called with lock held.
+ * @return  Timestamp for bus_done(). Zero when profiling hook unused.
+ */
+uint32_t MtdBase::bus_begin(mtd_op_t op, uint32_t offset, size_t len) {
+  uint32_t t0 = 0;
+
+#if MTD_USE_POWER
+  if (!awake)
+    power_up();
+#endif
+
+  if (nullptr != cfg.hook_event) {
+    t0 = MTD_STATS_TIMESTAMP();
+    event(MTD_EVENT_BUS_BEGIN, op, offset, len, 0, t0);
   }
 
-EXIT:
-  return written;
+  return t0;
 }
 
-/*
- ******************************************************************************
- * EXPORTED FUNCTIONS
- ******************************************************************************
+/**
+ * @brief   Accounts single bus transaction.
+ * @note    Called with lock held.
  */
+void MtdBase::bus_done(mtd_op_t op, uint32_t offset, size_t req, size_t got,
+                       uint32_t t0) {
+  bus_cnt++;
+#if MTD_USE_POWER
+  last_busy = chVTGetSystemTimeX();
+#endif
 
-/*
- * The rules of thumb for best performance write buffer.
- * It must be big enough to store:
- * 1) Size of your IC's page + ADDRESS_BYTES + command bytes (if any) for EEPROM.
- * 2) for FRAM there is no such strict rule - good chose is 16..64
+#if MTD_USE_STATS
+  osalSysLock();
+  if (MTD_OP_WRITE == op)
+    stats.programs++;
+  else if (MTD_OP_ERASE == op)
+    stats.erases++;
+  if (req != got)
+    stats.bus_errors++;
+  osalSysUnlock();
+#endif
+
+  if (nullptr != cfg.hook_event)
+    event(MTD_EVENT_BUS_END, op, offset, req, got, t0);
+}
+
+/**
+ * @brief   Counts program of every block touched by bus write.
+ * @note    Called with lock held. Failed program is counted too,
+ *          cells may be already stressed.
  */
-MtdBase::MtdBase(const MtdConfig &cfg, uint8_t *writebuf, size_t writebuf_size) :
-cfg(cfg),
-writebuf(writebuf),
-writebuf_size(writebuf_size)
-#if (MTD_USE_MUTUAL_EXCLUSION && !CH_CFG_USE_MUTEXES)
-  ,semaphore(true)
+void MtdBase::wear_account(size_t len, uint32_t offset) {
+#if MTD_USE_WEAR
+  if ((nullptr != wear) && (0 != len)) {
+    const uint32_t bs = wear_blocksize();
+    const uint32_t last = (offset + len - 1) / bs;
+
+    osalSysLock();
+    for (uint32_t b=offset/bs; b<=last; b++)
+      wear[b]++;
+    wear_unsaved++;
+    osalSysUnlock();
+  }
+#else
+  (void)len;
+  (void)offset;
 #endif
-{
-  return;
 }
 
 /**
- * @return number of written bytes
+ * @brief   Saves counters when enough programs accumulated.
+ * @note    Called after top level write with lock released.
  */
-size_t MtdBase::write(const uint8_t *data, size_t len, uint32_t offset) {
-  size_t ret;
+void MtdBase::wear_tick(void) {
+#if MTD_USE_WEAR && (MTD_WEAR_SAVE_EVERY > 0)
+  bool save;
 
-  if (nullptr != cfg.hook_start_write)
-    cfg.hook_start_write(this);
+  osalSysLock();
+  save = (MTD_WEAR_NO_REGION != wear_region) && !wear_saving &&
+         (wear_unsaved >= MTD_WEAR_SAVE_EVERY);
+  osalSysUnlock();
 
-  if (1 == cfg.pages) { /* FRAM */
-    ret = split_by_buffer(data, len, offset);
+  if (save)
+    wear_save();
+#endif
+}
+
+#if MTD_USE_POWER
+/**
+ * @brief   Wakes sleeping device before bus transaction.
+ * @note    Called with lock held. Failed wake is not reported here,
+ *          following transaction fails by itself.
+ */
+void MtdBase::power_up(void) {
+  (void)bus_power(true);
+  awake = true;
+
+#if MTD_USE_STATS
+  osalSysLock();
+  stats.wakeups++;
+  osalSysUnlock();
+#endif
+}
+
+/**
+ * @brief   Writes all queued deferred writes in arrival order.
+ * @note    Must be called with lock held. Lock is not yielded, nobody
+ *          may read data still sitting in queue.
+ * @return  OSAL_FAILED if any write failed, failed data is dropped.
+ */
+bool MtdBase::defer_drain(void) {
+  const size_t yield = yield_pages;
+  const size_t used = defer_used;
+  size_t pos = 0;
+  bool ret = OSAL_SUCCESS;
+
+  defer_used = 0;
+  yield_pages = 0;
+  while (pos < used) {
+    mtd_defer_hdr_t h;
+    size_t got;
+
+    memcpy(&h, &defer_pool[pos], sizeof(h));
+    pos += sizeof(h);
+
+    const uint32_t t0 = op_begin(MTD_OP_WRITE, h.offset, h.len);
+    if (1 == cfg.pages)
+      got = split_by_buffer(&defer_pool[pos], h.len, h.offset);
+    else
+      got = split_by_page(&defer_pool[pos], h.len, h.offset);
+    op_end(MTD_OP_WRITE, h.offset, h.len, got, t0, write_split(h.len, h.offset));
+
+    if (h.len != got)
+      ret = OSAL_FAILED;
+    pos += h.len;
   }
-  else {  /* page organized EEPROM */
-    ret = split_by_page(data, len, offset);
+  yield_pages = yield;
+
+  return ret;
+}
+
+/**
+ * @brief   Thread putting device to sleep after idle time.
+ */
+void MtdBase::power_manager(void *arg) {
+  MtdBase *self = static_cast<MtdBase *>(arg);
+
+  while (true) {
+    const systime_t t = self->power_idle();
+    osalThreadSleep((0 != t) ? t : self->defer_window);
   }
+}
+#endif /* MTD_USE_POWER */
 
-  if (nullptr != cfg.hook_stop_write)
-    cfg.hook_stop_write(this);
+/**
+ * @brief   Marks start of top level operation.
+ * @return  Timestamp of operation start.
+ */
+uint32_t MtdBase::op_begin(mtd_op_t op, uint32_t offset, size_t len) {
+  uint32_t t0 = 0;
+
+  if ((MTD_USE_STATS || MTD_USE_TRACE) || (nullptr != cfg.hook_event))
+    t0 = MTD_STATS_TIMESTAMP();
+
+  if (nullptr != cfg.hook_event)
+    event(MTD_EVENT_OP_BEGIN, op, offset, len, 0, t0);
+
+  return t0;
+}
+
+/**
+ * @brief   Accounts finished top level operation in statistics and trace.
+ */
+void MtdBase::op_end(mtd_op_t op, uint32_t offset, size_t req, size_t done,
+                     uint32_t t0, bool split) {
+#if MTD_USE_STATS || MTD_USE_TRACE
+  const uint32_t dt = MTD_STATS_ELAPSED_US(t0, MTD_STATS_TIMESTAMP());
+#endif
+#if MTD_USE_STATS
+  const size_t b = stats_bucket(dt);
+  mtd_op_stats_t *s = &stats.op[op];
+#endif
+#if MTD_USE_TRACE
+  const uint32_t thread = MTD_TRACE_THREAD();
+#endif
+
+  osalSysLock();
+#if MTD_USE_STATS
+  s->ops++;
+  s->bytes += done;
+  if (req != done)
+    s->errors++;
+  s->hist[b]++;
+  if (split)
+    stats.splits++;
+#endif
+#if MTD_USE_TRACE
+  mtd_trace_t *t = &trace[trace_head % MTD_TRACE_DEPTH];
+  trace_head++;
+  t->time     = MTD_STATS_ELAPSED_US(0, t0);
+  t->duration = dt;
+  t->thread   = thread;
+  t->offset   = offset;
+  t->len      = req;
+  t->done     = done;
+  t->op       = op;
+#endif
+  osalSysUnlock();
+
+  if (nullptr != cfg.hook_event)
+    event(MTD_EVENT_OP_END, op, offset, req, done, t0);
+
+  (void)split;
+}
+
+/**
+ * @brief   Splits read into pieces not exceeding DMA limit.
+ * @note    Must be called with lock held.
+ * @return  Number of read bytes.
+ */
+size_t MtdBase::chunked_read(uint8_t *rxbuf, size_t len, uint32_t offset) {
+  size_t ret = 0;
+
+  while (ret < len) {
+    size_t L = len - ret;
+    if (L > MTD_BUS_READ_MAX)
+      L = MTD_BUS_READ_MAX;
+    const uint32_t t0 = bus_begin(MTD_OP_READ, offset + ret, L);
+    const size_t got = bus_read(&rxbuf[ret], L, offset + ret);
+    bus_done(MTD_OP_READ, offset + ret, L, got, t0);
+    if (L != got)
+      break;
+    ret += L;
+  }
 
   return ret;
 }
 
 /**
- * @return number of read bytes
+ * @brief   Reads ranges sorted by offset, merging neighbours into
+ *          single bus transaction through write buffer.
+ * @note    Must be called with lock held.
+ * @return  Number of read bytes.
  */
-size_t MtdBase::read(uint8_t *rxbuf, size_t len, uint32_t offset) {
-  size_t ret;
+size_t MtdBase::merged_read(read_range_t *ranges, size_t cnt) {
+  size_t room = 0;
+  size_t ret = 0;
+  size_t i = 0;
 
-  if (nullptr != cfg.hook_start_read)
-    cfg.hook_start_read(this);
+  /* reads use only preamble part of write buffer, rest of it is free */
+  if (nullptr != writebuf)
+    room = writebuf_size - preamble_len();
 
-  ret = bus_read(rxbuf, len, offset);
+  while (i < cnt) {
+    const uint32_t start = ranges[i].offset;
+    uint32_t end = start + ranges[i].len;
+    size_t j = i + 1;
 
-  if (nullptr != cfg.hook_stop_read)
-    cfg.hook_stop_read(this);
+    while ((j < cnt) && (ranges[j].offset <= (end + MTD_READ_BATCH_GAP))) {
+      uint32_t e = ranges[j].offset + ranges[j].len;
+      if (e < end)
+        e = end;
+      if ((e - start) > room)
+        break;
+      end = e;
+      j++;
+    }
 
+    if ((i + 1) == j) {
+      if (ranges[i].len != chunked_read(ranges[i].buf, ranges[i].len, start))
+        goto EXIT;
+      ret += ranges[i].len;
+    }
+    else {
+      uint8_t *span = &writebuf[preamble_len()];
+      const uint32_t t0 = bus_begin(MTD_OP_READ, start, end - start);
+      const size_t got = bus_read(span, end - start, start);
+      bus_done(MTD_OP_READ, start, end - start, got, t0);
+      if ((end - start) != got)
+        goto EXIT;
+      for (size_t k=i; k<j; k++) {
+        memcpy(ranges[k].buf, &span[ranges[k].offset - start], ranges[k].len);
+        ret += ranges[k].len;
+      }
+    }
+    i = j;
+  }
+
+EXIT:
   return ret;
 }
 
+/**
+ * @brief   Size of next piece of gathered write.
+ * @details Bounded by page boundary (EEPROM) and write buffer size.
+ */
+size_t MtdBase::gather_len(size_t len, uint32_t offset) {
+  size_t L = writebuf_size - preamble_len();
+
+  if (cfg.pages > 1) {
+    const size_t page_tail = cfg.pagesize - (offset % cfg.pagesize);
+    if (L > page_tail)
+      L = page_tail;
+  }
+
+  if (L > len)
+    L = len;
+
+  return L;
+}
+
+/**
+ * @brief   Fills data from scatter list directly into write buffer
+ *          and writes it with single bus transaction per page.
+ * @note    Must be called with lock held.
+ * @return  Number of written bytes.
+ */
+size_t MtdBase::gathered_write(const iovec_t *iov, size_t iovcnt, size_t total,
+                               uint32_t offset) {
+  const size_t pre = preamble_len();
+  uint8_t *payload = &writebuf[pre];
+  size_t written = 0;
+  size_t i = 0;   /* current element of list */
+  size_t pos = 0; /* position inside current element */
+  size_t status;
+  uint32_t t0;
+
+  osalDbgCheck(writebuf_size > pre);
+
+  while (written < total) {
+    const size_t L = gather_len(total - written, offset);
+    size_t filled = 0;
+
+    while (filled < L) {
+      osalDbgCheck(i < iovcnt);
+      size_t n = iov[i].len - pos;
+      if (n > L - filled)
+        n = L - filled;
+      memcpy(&payload[filled], static_cast<const uint8_t *>(iov[i].base) + pos, n);
+      filled += n;
+      pos += n;
+      if (pos == iov[i].len) {
+        i++;
+        pos = 0;
+      }
+    }
+
+    t0 = bus_begin(MTD_OP_WRITE, offset, L);
+    status = bus_write(payload, L, offset);
+    bus_done(MTD_OP_WRITE, offset, L, status, t0);
+    wear_account(L, offset);
+    write_yield();
+    if (L != status)
+      goto EXIT;
+
+    written += L;
+    offset += L;
+  }
+
+EXIT:
+  return written;
+}
+
+/**
+ * @brief   Moves single chunk fitted in destination page: bus read
+ *          straight into buffer and bus write from the same place.
+ * @note    Must be called with lock held.
+ * @return  Number of copied bytes.
+ */
+size_t MtdBase::copy_chunk(uint8_t *buf, size_t L, uint32_t src, uint32_t dst) {
+  size_t got;
+  uint32_t t0;
+
+  t0 = bus_begin(MTD_OP_READ, src, L);
+  got = bus_read(buf, L, src);
+  bus_done(MTD_OP_READ, src, L, got, t0);
+  if (L != got)
+    return 0;
+
+  t0 = bus_begin(MTD_OP_WRITE, dst, L);
+  got = bus_write(buf, L, dst);
+  bus_done(MTD_OP_WRITE, dst, L, got, t0);
+  wear_account(L, dst);
+  write_yield();
+
+  return got;
+}
+
+/**
+ * @brief   Moves range through caller's buffer: single bus read per
+ *          buffer fill, program of it split like in write().
+ * @details Buffer of len bytes gives the same bus transactions as
+ *          read() followed by write().
+ * @note    Must be called with lock held.
+ * @return  Number of copied bytes.
+ */
+size_t MtdBase::copy_buffered(uint8_t *buf, size_t buflen, uint32_t src,
+                              uint32_t dst, size_t len, bool backward) {
+  size_t ret = 0;
+
+  while (ret < len) {
+    const size_t left = len - ret;
+    const size_t L = (left > buflen) ? buflen : left;
+    const uint32_t pos = backward ? (left - L) : ret;
+    size_t got;
+
+    if (L != chunked_read(buf, L, src + pos))
+      break;
+    if (1 == cfg.pages)
+      got = split_by_buffer(buf, L, dst + pos);
+    else
+      got = split_by_page(buf, L, dst + pos);
+    if (L != got)
+      break;
+    ret += L;
+  }
+
+  return ret;
+}
+
+/**
+ * @brief   Reads range through buffer comparing it with reference data
+ *          or, when reference is nullptr, with pattern byte. Stops on
+ *          first mismatch.
+ * @note    Must be called with lock held. Buffer content is destroyed.
+ * @return  Number of leading bytes equal to reference. Bus error counts
+ *          as mismatch.
+ */
+size_t MtdBase::matched_read(uint8_t *buf, size_t room, uint32_t offset,
+                             size_t len, const uint8_t *ref, uint8_t pattern) {
+  size_t ret = 0;
+
+  while (ret < len) {
+    size_t L = len - ret;
+    size_t got, m;
+    uint32_t t0;
+
+    if (L > room)
+      L = room;
+
+    t0 = bus_begin(MTD_OP_READ, offset + ret, L);
+    got = bus_read(buf, L, offset + ret);
+    bus_done(MTD_OP_READ, offset + ret, L, got, t0);
+    if (L != got)
+      break;
+
+    m = match_len(buf, (nullptr != ref) ? &ref[ret] : nullptr, pattern, L);
+    ret += m;
+    if (m != L)
+      break;
+  }
+
+  return ret;
+}
+
+/**
+ * @brief   Payload part of write buffer used as scratch by copy, fill
+ *          and compare. Devices without write buffer get caller's one.
+ */
+uint8_t *MtdBase::scratch(uint8_t *bounce, size_t *room) {
+  if (nullptr == writebuf)
+    return bounce;
+
+  *room = writebuf_size - preamble_len();
+  return &writebuf[preamble_len()];
+}
+
+/**
+ * @brief   Erases single sector accounting it like page program.
+ * @note    Must be called with lock held.
+ * @return  OSAL_FAILED on error.
+ */
+bool MtdBase::sector_erase(uint32_t offset) {
+  const uint32_t es = erasesize();
+  bool status;
+  uint32_t t0;
+
+  t0 = bus_begin(MTD_OP_ERASE, offset, es);
+  status = bus_erase_sector(offset);
+  bus_done(MTD_OP_ERASE, offset, es, (OSAL_SUCCESS == status) ? es : 0, t0);
+  wear_account(es, offset);
+  write_yield();
+
+  return status;
+}
+
+/**
+ * @brief   Fills range with pattern, buffer is used as scratch.
+ * @details Every piece is one page program from the same buffer, 0xFF
+ *          over whole sectors is one erase command. EEPROM pieces
+ *          already holding pattern are skipped after blank check,
+ *          FRAM writes at read speed and is never checked.
+ * @note    Must be called with lock held.
+ * @return  Number of filled bytes.
+ */
+size_t MtdBase::filled_write(uint8_t *buf, size_t room, uint32_t offset,
+                             size_t len, uint8_t pattern) {
+  const uint32_t es = erasesize();
+  const bool check = !is_fram();
+  size_t ret = 0;
+
+  while (ret < len) {
+    const uint32_t pos = offset + ret;
+    const bool erase = (0xFF == pattern) && (0 != es) &&
+                       (0 == (pos % es)) && ((len - ret) >= es);
+    size_t L;
+
+    if (erase) {
+      L = es;
+    }
+    else {
+      L = gather_len(len - ret, pos);
+      if (L > room)
+        L = room;
+    }
+
+    if (check) {
+      if (L == matched_read(buf, room, pos, L, nullptr, pattern)) {
+        ret += L;
+        continue;
+      }
+    }
+
+    if (erase) {
+      if (OSAL_SUCCESS != sector_erase(pos))
+        break;
+    }
+    else {
+      /* refilled every time: buffer is shared, write yield lets other
+         writers use it between iterations */
+      memset(buf, pattern, L);
+      if (L != fitted_write(buf, L, pos))
+        break;
+    }
+    ret += L;
+  }
+
+  return ret;
+}
+
+/**
+ * @brief   Top level fill shared by fill() and erase().
+ */
+size_t MtdBase::fill_op(mtd_op_t op, uint32_t offset, size_t len,
+                        uint8_t pattern) {
+  const uint32_t t0 = op_begin(op, offset, len);
+  const mtdcb_t start = (MTD_OP_ERASE == op) ? cfg.hook_start_erase :
+                                               cfg.hook_start_write;
+  const mtdcb_t stop = (MTD_OP_ERASE == op) ? cfg.hook_stop_erase :
+                                              cfg.hook_stop_write;
+  uint8_t bounce[32];
+  size_t room = sizeof(bounce);
+  uint8_t *buf = scratch(bounce, &room);
+  size_t ret;
+
+  osalDbgAssert((offset + len) <= capacity(), "Transaction out of device bounds");
+
+  if (nullptr != start)
+    start(this);
+
+  this->acquire();
+  burst = 0;
+  ret = filled_write(buf, room, offset, len, pattern);
+  this->release();
+
+  if (nullptr != stop)
+    stop(this);
+
+  op_end(op, offset, len, ret, t0, gather_len(len, offset) < len);
+  wear_tick();
+  return ret;
+}
+
+/**
+ * @brief   Splits big transaction into smaller ones fitted into MTD's buffer.
+ * @details Drivers with burst support get whole transaction at once.
+ */
+size_t MtdBase::split_by_buffer(const uint8_t *txdata, size_t len, uint32_t offset) {
+  size_t written = 0;
+  size_t tmp;
+  const uint32_t blocksize = this->writebuf_size - cfg.addr_len;
+
+  /* payload does not go through write buffer, its size does not matter */
+  if (0 != burst_max())
+    return burst_write(txdata, len, offset);
+
+  const uint32_t big_writes = len / blocksize;
+  const uint32_t small_write_size = len % blocksize;
+
+  /* write big blocks */
+  for (size_t i=0; i<big_writes; i++) {
+    tmp = fitted_write(txdata, blocksize, offset);
+    if (blocksize == tmp) {
+      txdata += tmp;
+      offset += tmp;
+      written += tmp;
+    }
+    else
+      goto EXIT;
+  }
+
+  /* write tail (if any) */
+  if (small_write_size > 0) {
+    tmp = fitted_write(txdata, small_write_size, offset);
+    if (small_write_size == tmp)
+      written += tmp;
+  }
+
+EXIT:
+  return written;
+}
+
+/**
+ * @brief   Splits big transaction into smaller ones fitted into memory page.
+ * @return  Number of written bytes.
+ */
+size_t MtdBase::split_by_page(const uint8_t *txdata, size_t len, uint32_t offset) {
+
+  /* bytes to be written at one transaction */
+  size_t L = 0;
+  /* total bytes successfully written */
+  size_t written = 0;
+  size_t status = 0;
+  /* cached value */
+  const uint32_t pagesize = cfg.pagesize;
+  /* first page to be affected during transaction */
+  const uint32_t firstpage = offset / pagesize;
+  /* last page to be affected during transaction */
+  const uint32_t lastpage = (offset + len - 1) / pagesize;
+
+  /* data fits in single page */
+  if (firstpage == lastpage) {
+    L = len;
+    written = fitted_write(txdata, L, offset);
+    txdata += L;
+    offset += L;
+    goto EXIT;
+  }
+  else{
+    /* write first piece of data to the first page boundary */
+    L = firstpage * pagesize + pagesize - offset;
+    status = fitted_write(txdata, L, offset);
+    if (status != L)
+      goto EXIT;
+    else
+      written += status;
+    txdata += L;
+    offset += L;
+
+    /* now writes blocks at a size of pages (may be no one) */
+    L = pagesize;
+    while ((len - written) > pagesize){
+      status = fitted_write(txdata, L, offset);
+      if (status != L)
+        goto EXIT;
+      else
+        written += status;
+      txdata += L;
+      offset += L;
+    }
+
+    /* write tail */
+    L = len - written;
+    if (0 == L)
+      goto EXIT;
+    else{
+      written += fitted_write(txdata, L, offset);
+    }
+  }
+
+EXIT:
+  return written;
+}
+
+/*
+ ******************************************************************************
+ * EXPORTED FUNCTIONS
+ ******************************************************************************
+ */
+
+/*
+ * The rules of thumb for best performance write buffer.
+ * It must be big enough to store:
+ * 1) Size of your IC's page + ADDRESS_BYTES + command bytes (if any) for EEPROM.
+ * 2) for FRAM there is no such strict rule - good chose is 16..64
+ */
+MtdBase::MtdBase(const MtdConfig &cfg, uint8_t *writebuf, size_t writebuf_size) :
+cfg(cfg),
+writebuf(writebuf),
+writebuf_size(writebuf_size),
+bus_cnt(0),
+programtime(cfg.programtime),
+yield_pages(MTD_WRITE_YIELD_PAGES),
+burst(0)
+#if (MTD_USE_MUTUAL_EXCLUSION && !CH_CFG_USE_MUTEXES)
+  ,semaphore(true)
+#endif
+{
+  memset(&calib, 0, sizeof(calib));
+  calib.programtime = cfg.programtime;
+#if MTD_USE_STATS
+  memset(&stats, 0, sizeof(stats));
+#endif
+#if MTD_USE_TRACE
+  trace_head = 0;
+#endif
+#if MTD_USE_POWER
+  awake = true;
+  last_busy = chVTGetSystemTimeX();
+  defer_pool = nullptr;
+  defer_size = 0;
+  defer_used = 0;
+  defer_window = 0;
+  defer_since = 0;
+#endif
+#if MTD_USE_WEAR
+  wear = nullptr;
+  wear_blocks = 0;
+  wear_region = MTD_WEAR_NO_REGION;
+  wear_unsaved = 0;
+  wear_saving = false;
+#endif
+}
+
+/**
+ * @brief   Writes data splitting it by pages (EEPROM) or write buffer (FRAM).
+ * @details Lock is taken once for whole write, see MTD_WRITE_YIELD_PAGES.
+ *
+ * @return number of written bytes
+ */
+size_t MtdBase::write(const uint8_t *data, size_t len, uint32_t offset) {
+  const uint32_t t0 = op_begin(MTD_OP_WRITE, offset, len);
+  size_t ret;
+
+  if (nullptr != cfg.hook_start_write)
+    cfg.hook_start_write(this);
+
+  this->acquire();
+  burst = 0;
+  if (1 == cfg.pages) { /* FRAM */
+    ret = split_by_buffer(data, len, offset);
+  }
+  else {  /* page organized EEPROM */
+    ret = split_by_page(data, len, offset);
+  }
+  this->release();
+
+  if (nullptr != cfg.hook_stop_write)
+    cfg.hook_stop_write(this);
+
+  op_end(MTD_OP_WRITE, offset, len, ret, t0, write_split(len, offset));
+  wear_tick();
+  return ret;
+}
+
+/**
+ * @return number of read bytes
+ */
+size_t MtdBase::read(uint8_t *rxbuf, size_t len, uint32_t offset) {
+  const uint32_t t0 = op_begin(MTD_OP_READ, offset, len);
+  size_t ret;
+
+  if (nullptr != cfg.hook_start_read)
+    cfg.hook_start_read(this);
+
+  this->acquire();
+  ret = chunked_read(rxbuf, len, offset);
+  this->release();
+
+  if (nullptr != cfg.hook_stop_read)
+    cfg.hook_stop_read(this);
+
+  op_end(MTD_OP_READ, offset, len, ret, t0, false);
+  return ret;
+}
+
+/**
+ * @brief   Writes data collected from several buffers as single
+ *          continuous region starting at offset.
+ * @note    Elements of list are packed into page buffer, so header and
+ *          payload fitted in one page are written by one page program.
+ *
+ * @return  number of written bytes
+ */
+size_t MtdBase::writev(const iovec_t *iov, size_t iovcnt, uint32_t offset) {
+  uint32_t t0;
+  size_t total = 0;
+  size_t ret = 0;
+
+  osalDbgCheck((nullptr != iov) && (0 != iovcnt));
+
+  for (size_t i=0; i<iovcnt; i++)
+    total += iov[i].len;
+
+  osalDbgAssert((offset + total) <= capacity(), "Transaction out of device bounds");
+
+  t0 = op_begin(MTD_OP_WRITE, offset, total);
+
+  if (nullptr != cfg.hook_start_write)
+    cfg.hook_start_write(this);
+
+  this->acquire();
+  burst = 0;
+  if (nullptr != writebuf) {
+    ret = gathered_write(iov, iovcnt, total, offset);
+  }
+  else { /* no buffer to gather in, write elements one by one */
+    for (size_t i=0; i<iovcnt; i++) {
+      if (0 == iov[i].len)
+        continue;
+      const uint8_t *data = static_cast<const uint8_t *>(iov[i].base);
+      size_t tmp;
+      if (1 == cfg.pages)
+        tmp = split_by_buffer(data, iov[i].len, offset + ret);
+      else
+        tmp = split_by_page(data, iov[i].len, offset + ret);
+      ret += tmp;
+      if (tmp != iov[i].len)
+        break;
+    }
+  }
+  this->release();
+
+  if (nullptr != cfg.hook_stop_write)
+    cfg.hook_stop_write(this);
+
+  op_end(MTD_OP_WRITE, offset, total, ret, t0, gather_len(total, offset) < total);
+  wear_tick();
+  return ret;
+}
+
+/**
+ * @brief   Reads continuous region starting at offset into several buffers.
+ * @note    Lock is taken once for whole list.
+ *
+ * @return  number of read bytes
+ */
+size_t MtdBase::readv(const iovec_t *iov, size_t iovcnt, uint32_t offset) {
+  uint32_t t0;
+  size_t total = 0;
+  size_t ret = 0;
+
+  osalDbgCheck((nullptr != iov) && (0 != iovcnt));
+
+  for (size_t i=0; i<iovcnt; i++)
+    total += iov[i].len;
+
+  t0 = op_begin(MTD_OP_READ, offset, total);
+
+  if (nullptr != cfg.hook_start_read)
+    cfg.hook_start_read(this);
+
+  this->acquire();
+  for (size_t i=0; i<iovcnt; i++) {
+    if (0 == iov[i].len)
+      continue;
+    uint8_t *data = static_cast<uint8_t *>(iov[i].base);
+    const size_t tmp = chunked_read(data, iov[i].len, offset + ret);
+    ret += tmp;
+    if (tmp != iov[i].len)
+      break;
+  }
+  this->release();
+
+  if (nullptr != cfg.hook_stop_read)
+    cfg.hook_stop_read(this);
+
+  op_end(MTD_OP_READ, offset, total, ret, t0, false);
+  return ret;
+}
+
+/**
+ * @brief   Reads many small disjoint ranges.
+ * @details Ranges are sorted by offset in place. Ranges separated by
+ *          gap smaller than MTD_READ_BATCH_GAP are read by single
+ *          sequential transaction. Lock is taken once for whole batch.
+ *
+ * @return  number of read bytes (sum of ranges lengths on success)
+ */
+size_t MtdBase::read_batch(read_range_t *ranges, size_t cnt) {
+  uint32_t t0;
+  size_t total = 0;
+  size_t ret;
+
+  osalDbgCheck((nullptr != ranges) && (0 != cnt));
+
+  /* insertion sort, batches are short */
+  for (size_t i=1; i<cnt; i++) {
+    const read_range_t tmp = ranges[i];
+    size_t j = i;
+    while ((j > 0) && (ranges[j-1].offset > tmp.offset)) {
+      ranges[j] = ranges[j-1];
+      j--;
+    }
+    ranges[j] = tmp;
+  }
+
+  for (size_t i=0; i<cnt; i++) {
+    osalDbgCheck((nullptr != ranges[i].buf) && (0 != ranges[i].len));
+    osalDbgAssert((ranges[i].offset + ranges[i].len) <= capacity(),
+                  "Transaction out of device bounds");
+    total += ranges[i].len;
+  }
+
+  t0 = op_begin(MTD_OP_READ, ranges[0].offset, total);
+
+  if (nullptr != cfg.hook_start_read)
+    cfg.hook_start_read(this);
+
+  this->acquire();
+  ret = merged_read(ranges, cnt);
+  this->release();
+
+  if (nullptr != cfg.hook_stop_read)
+    cfg.hook_stop_read(this);
+
+  op_end(MTD_OP_READ, ranges[0].offset, total, ret, t0, false);
+  return ret;
+}
+
+/**
+ * @brief   Reads region by chunks handing every chunk to consumer.
+ * @details Whole region never staged in RAM, only chunkbuf is used.
+ *          Lock is released while consumer works, so slow consumer
+ *          (serial link for example) does not block other users.
+ *
+ * @param[in] chunkbuf  buffer for single chunk
+ * @param[in] chunklen  size of chunkbuf. Clamped to MTD_BUS_READ_MAX.
+ * @param[in] cb        consumer. Returns OSAL_FAILED to stop streaming.
+ *
+ * @return  number of bytes passed to consumer
+ */
+size_t MtdBase::read_stream(uint8_t *chunkbuf, size_t chunklen, size_t len,
+                            uint32_t offset, mtdstreamcb_t cb, void *arg) {
+  const uint32_t t0 = op_begin(MTD_OP_READ, offset, len);
+  size_t ret = 0;
+  size_t req = 0; /* set on bus failure, consumer stop is not an error */
+
+  osalDbgCheck((nullptr != chunkbuf) && (0 != chunklen) && (nullptr != cb));
+  osalDbgAssert((offset + len) <= capacity(), "Transaction out of device bounds");
+
+  if (chunklen > MTD_BUS_READ_MAX)
+    chunklen = MTD_BUS_READ_MAX;
+
+  if (nullptr != cfg.hook_start_read)
+    cfg.hook_start_read(this);
+
+  while (ret < len) {
+    size_t L = len - ret;
+    size_t status;
+    uint32_t tb;
+    if (L > chunklen)
+      L = chunklen;
+
+    this->acquire();
+    tb = bus_begin(MTD_OP_READ, offset + ret, L);
+    status = bus_read(chunkbuf, L, offset + ret);
+    bus_done(MTD_OP_READ, offset + ret, L, status, tb);
+    this->release();
+
+    if (L != status) {
+      req = len;
+      break;
+    }
+    ret += L;
+    if (OSAL_SUCCESS != cb(chunkbuf, L, arg))
+      break;
+  }
+
+  if (nullptr != cfg.hook_stop_read)
+    cfg.hook_stop_read(this);
+
+  if (0 == req)
+    req = ret;
+  op_end(MTD_OP_READ, offset, req, ret, t0, false);
+  return ret;
+}
+
+/**
+ * @brief   Copies region inside device without user buffers.
+ * @details Data goes through payload part of write buffer in chunks
+ *          fitted in destination pages, so every chunk costs one bus
+ *          read and one page program without memcpy. Overlapping
+ *          ranges are handled like memmove: backward when destination
+ *          is above source. Lock is held for whole copy (see
+ *          MTD_WRITE_YIELD_PAGES). Accounted as write of destination.
+ *          Without write buffer the chunk is one page at most, so copy
+ *          takes a bus read per page where read() plus write() takes
+ *          one read. Optional caller's buffer bigger than write buffer
+ *          is filled by single read instead.
+ * @note    Read can not overlap program of previous chunk on the same
+ *          chip: EEPROM and NOR flash do not serve reads while busy.
+ *
+ * @param[in] buf       optional bounce buffer, set to nullptr if unused
+ * @param[in] buflen    size of bounce buffer
+ *
+ * @return  number of copied bytes
+ */
+size_t MtdBase::copy(uint32_t src, uint32_t dst, size_t len,
+                     uint8_t *buf, size_t buflen) {
+  const uint32_t t0 = op_begin(MTD_OP_WRITE, dst, len);
+  const bool backward = (dst > src) && (dst < (src + len));
+  uint8_t bounce[32];
+  size_t room = sizeof(bounce);
+  uint8_t *sbuf = scratch(bounce, &room);
+  size_t ret = 0;
+
+  osalDbgAssert(((src + len) <= capacity()) && ((dst + len) <= capacity()),
+                "Transaction out of device bounds");
+
+  if (nullptr != cfg.hook_start_write)
+    cfg.hook_start_write(this);
+
+  this->acquire();
+  burst = 0;
+  if ((nullptr == buf) || (buflen <= room)) {
+    buf = nullptr; /* write buffer is the bigger one */
+  }
+  else if (src != dst) {
+    ret = copy_buffered(buf, buflen, src, dst, len, backward);
+  }
+  while ((ret < len) && (src != dst) && (nullptr == buf)) {
+    const size_t left = len - ret;
+    uint32_t d;
+    size_t L;
+
+    if (backward) {
+      /* walk down from the end, chunk must not cross page start */
+      const uint32_t end = dst + left;
+      L = left;
+      if ((cfg.pages > 1) && (L > (((end - 1) % cfg.pagesize) + 1)))
+        L = ((end - 1) % cfg.pagesize) + 1;
+      if (L > room)
+        L = room;
+      d = end - L;
+    }
+    else {
+      d = dst + ret;
+      L = gather_len(left, d);
+      if (L > room)
+        L = room;
+    }
+
+    if (L != copy_chunk(sbuf, L, src + (d - dst), d))
+      break;
+    ret += L;
+  }
+  if (src == dst)
+    ret = len;
+  this->release();
+
+  if (nullptr != cfg.hook_stop_write)
+    cfg.hook_stop_write(this);
+
+  op_end(MTD_OP_WRITE, dst, len, ret, t0, gather_len(len, dst) < len);
+  wear_tick();
+  return ret;
+}
+
+/**
+ * @brief   Fills range with single byte pattern.
+ * @details One page sized pattern buffer is programmed page by page,
+ *          pages already holding pattern are skipped. On devices with
+ *          erase command 0xFF fill of whole sectors is mapped to
+ *          sector erases.
+ *
+ * @return  number of filled bytes
+ */
+size_t MtdBase::fill(uint32_t offset, size_t len, uint8_t pattern) {
+  return fill_op(MTD_OP_WRITE, offset, len, pattern);
+}
+
+/**
+ * @brief   Brings range to erased (0xFF) state.
+ * @details Same as fill() with 0xFF but accounted as erase.
+ * @note    NOR flash can not raise bits by program, range there must
+ *          be aligned to erasesize().
+ *
+ * @return  number of erased bytes
+ */
+size_t MtdBase::erase(uint32_t offset, size_t len) {
+  osalDbgAssert((0 == erasesize()) ||
+                ((0 == (offset % erasesize())) && (0 == (len % erasesize()))),
+                "Range not aligned to sector");
+
+  return fill_op(MTD_OP_ERASE, offset, len, 0xFF);
+}
+
+/**
+ * @brief   Top level compare shared by is_blank() and compare().
+ * @note    Accounted as read of matched bytes, mismatch is not an error.
+ */
+size_t MtdBase::match_op(uint32_t offset, size_t len, const uint8_t *ref,
+                         uint8_t pattern) {
+  const uint32_t t0 = op_begin(MTD_OP_READ, offset, len);
+  uint8_t bounce[32];
+  size_t room = sizeof(bounce);
+  uint8_t *buf = scratch(bounce, &room);
+  size_t ret;
+
+  osalDbgAssert((offset + len) <= capacity(), "Transaction out of device bounds");
+
+  if (nullptr != cfg.hook_start_read)
+    cfg.hook_start_read(this);
+
+  this->acquire();
+  ret = matched_read(buf, room, offset, len, ref, pattern);
+  this->release();
+
+  if (nullptr != cfg.hook_stop_read)
+    cfg.hook_stop_read(this);
+
+  op_end(MTD_OP_READ, offset, ret, ret, t0, false);
+  return ret;
+}
+
+/**
+ * @brief   Checks that range is in erased (0xFF) state.
+ * @details Streams range through write buffer, no user buffer needed.
+ *          Stops on first programmed byte.
+ */
+bool MtdBase::is_blank(uint32_t offset, size_t len) {
+  return len == match_op(offset, len, nullptr, 0xFF);
+}
+
+/**
+ * @brief   Compares range with data in RAM.
+ * @details Streams range through write buffer, no second buffer needed.
+ *          Stops on first mismatch.
+ *
+ * @return  number of leading equal bytes, len if whole range is equal
+ */
+size_t MtdBase::compare(uint32_t offset, const uint8_t *data, size_t len) {
+  osalDbgCheck(nullptr != data);
+
+  return match_op(offset, len, data, 0);
+}
+
+#if MTD_USE_POWER
+/**
+ * @brief   Puts device to sleep now. Next bus transaction wakes it.
+ * @note    Deferred writes stay queued.
+ *
+ * @return  OSAL_FAILED on error.
+ */
+bool MtdBase::power_down(void) {
+  bool ret = OSAL_SUCCESS;
+
+  this->lock();
+  if (awake) {
+    ret = bus_power(false);
+    if (OSAL_SUCCESS == ret)
+      awake = false;
+  }
+  this->release();
+
+  return ret;
+}
+
+/**
+ * @brief   Puts device to sleep if it was idle for MtdConfig::idletime.
+ * @details Call it periodically from low priority thread or use
+ *          start_power_manager(). Deferred writes are written here if
+ *          device is awake anyway or the oldest one waits longer than
+ *          deferral window.
+ *
+ * @return  Time until device may become idle enough or deferral window
+ *          expires, next call should not be earlier. 0 if there is
+ *          nothing to wait for.
+ */
+systime_t MtdBase::power_idle(void) {
+  systime_t ret = cfg.idletime;
+
+  this->lock();
+  if (0 != defer_used) {
+    const systime_t age = chVTGetSystemTimeX() - defer_since;
+    if (awake || (age >= defer_window))
+      (void)defer_drain();
+    else if ((0 == ret) || ((defer_window - age) < ret))
+      ret = defer_window - age;
+  }
+
+  if (awake && (0 != cfg.idletime)) {
+    const systime_t idle = chVTGetSystemTimeX() - last_busy;
+    if (idle < cfg.idletime)
+      ret = cfg.idletime - idle;
+    else if (OSAL_SUCCESS == bus_power(false))
+      awake = false;
+  }
+  this->release();
+
+  return ret;
+}
+
+/**
+ * @brief   Assigns queue for write_deferred().
+ * @details Queue holds 8 bytes of header per write plus its payload.
+ *          Window is the longest time deferred write may wait for
+ *          device wake, it is enforced by power_idle().
+ * @note    Set pool to nullptr to disable deferring, queued writes are
+ *          written first.
+ */
+void MtdBase::defer_start(uint8_t *pool, size_t size, systime_t window) {
+  osalDbgCheck((nullptr == pool) || (size > sizeof(mtd_defer_hdr_t)));
+
+  this->acquire();
+  defer_pool = pool;
+  defer_size = (nullptr == pool) ? 0 : size;
+  defer_window = window;
+  this->release();
+}
+
+/**
+ * @brief   Low priority write which does not wake sleeping device.
+ * @details Data is copied to queue while device sleeps. Queue is written
+ *          back in order before the next locked operation, so reads and
+ *          writes always see queued data, or by power_idle(). Awake
+ *          device, full queue or no queue mean plain write().
+ * @note    Queued data is lost on reset or power loss.
+ *
+ * @return  number of accepted bytes
+ */
+size_t MtdBase::write_deferred(const uint8_t *data, size_t len, uint32_t offset) {
+  const size_t need = sizeof(mtd_defer_hdr_t) + len;
+  mtd_defer_hdr_t h;
+
+  osalDbgCheck(nullptr != data);
+  osalDbgAssert((offset + len) <= capacity(), "Transaction out of device bounds");
+
+  this->lock();
+  if (awake || ((defer_size - defer_used) < need)) {
+    this->release();
+    return write(data, len, offset);
+  }
+
+  if (0 == defer_used)
+    defer_since = chVTGetSystemTimeX();
+  h.offset = offset;
+  h.len = len;
+  memcpy(&defer_pool[defer_used], &h, sizeof(h));
+  memcpy(&defer_pool[defer_used + sizeof(h)], data, len);
+  defer_used += need;
+  this->release();
+
+  return len;
+}
+
+/**
+ * @brief   Writes queued deferred writes now.
+ * @return  OSAL_FAILED if any of them failed.
+ */
+bool MtdBase::defer_flush(void) {
+  bool ret = OSAL_SUCCESS;
+
+  this->lock();
+  if (0 != defer_used)
+    ret = defer_drain();
+  this->release();
+
+  return ret;
+}
+
+/**
+ * @brief   Start thread putting device to sleep after idle time.
+ * @note    Needs MTD_USE_MUTUAL_EXCLUSION when device is used by
+ *          other threads.
+ */
+void MtdBase::start_power_manager(void *wsp, size_t size, tprio_t prio) {
+  osalDbgCheck((0 != cfg.idletime) || (0 != defer_window));
+
+  chThdCreateStatic(wsp, size, prio, power_manager, this);
+}
+#endif /* MTD_USE_POWER */
+
+#if MTD_USE_STATS
+/**
+ * @brief   Consistent snapshot of statistics.
+ */
+void MtdBase::stats_get(MtdStats *dst) {
+  osalSysLock();
+  *dst = stats;
+  osalSysUnlock();
+}
+
+/**
+ *
+ */
+void MtdBase::stats_reset(void) {
+  osalSysLock();
+  memset(&stats, 0, sizeof(stats));
+  osalSysUnlock();
+}
+#endif /* MTD_USE_STATS */
+
+#if MTD_USE_TRACE
+/**
+ * @brief   Copies last trace records, oldest first.
+ * @return  Number of copied records.
+ */
+size_t MtdBase::trace_get(mtd_trace_t *dst, size_t max) {
+  size_t n;
+
+  osalSysLock();
+  n = (trace_head < MTD_TRACE_DEPTH) ? trace_head : MTD_TRACE_DEPTH;
+  if (n > max)
+    n = max;
+  for (size_t i=0; i<n; i++)
+    dst[i] = trace[(trace_head - n + i) % MTD_TRACE_DEPTH];
+  osalSysUnlock();
+
+  return n;
+}
+
+/**
+ * @brief   Dumps whole trace buffer.
+ * @note    Records are copied by small portions, so dump does not
+ *          stop tracing for long.
+ */
+void MtdBase::trace_dump(BaseSequentialStream *chp) {
+  mtd_trace_t tmp[4];
+  uint32_t from;
+  uint32_t head;
+
+  osalSysLock();
+  head = trace_head;
+  osalSysUnlock();
+  from = (head < MTD_TRACE_DEPTH) ? 0 : head - MTD_TRACE_DEPTH;
+
+  trace_print_header(chp);
+  while ((int32_t)(head - from) > 0) {
+    size_t n = 0;
+    osalSysLock();
+    /* entries being overwritten by now are skipped */
+    if ((trace_head - from) > MTD_TRACE_DEPTH)
+      from = trace_head - MTD_TRACE_DEPTH;
+    while ((n < 4) && ((int32_t)(head - from) > 0)) {
+      tmp[n++] = trace[from % MTD_TRACE_DEPTH];
+      from++;
+    }
+    osalSysUnlock();
+    trace_print(chp, tmp, n);
+  }
+}
+#endif /* MTD_USE_TRACE */
+
+#if MTD_USE_WEAR
+/**
+ * @brief   Starts wear accounting.
+ * @details Counters are restored from reserved region when it holds
+ *          valid copy, otherwise they start from zero.
+ *
+ * @param[in] counters  array of 'blocks' counters owned by caller
+ * @param[in] blocks    capacity() / wear_blocksize()
+ * @param[in] region    offset of MTD_WEAR_REGION_SIZE(blocks) bytes reserved
+ *                      for counters or MTD_WEAR_NO_REGION
+ *
+ * @return  OSAL_SUCCESS if saved counters were restored.
+ */
+bool MtdBase::wear_start(uint32_t *counters, size_t blocks, uint32_t region) {
+  mtd_wear_hdr_t hdr;
+  const size_t len = blocks * sizeof(uint32_t);
+  bool ret = OSAL_FAILED;
+
+  osalDbgCheck((nullptr != counters) && ((capacity() / wear_blocksize()) == blocks));
+  osalDbgAssert((MTD_WEAR_NO_REGION == region) ||
+                ((region + MTD_WEAR_REGION_SIZE(blocks)) <= capacity()),
+                "Region out of device bounds");
+
+  wear_blocks = blocks;
+  wear_region = region;
+  wear_unsaved = 0;
+  wear_saving = false;
+
+  if (MTD_WEAR_NO_REGION == region)
+    goto EXIT;
+  if (sizeof(hdr) != read(reinterpret_cast<uint8_t *>(&hdr), sizeof(hdr), region))
+    goto EXIT;
+  if ((WEAR_MAGIC != hdr.magic) || (blocks != hdr.blocks))
+    goto EXIT;
+  if (len != read(reinterpret_cast<uint8_t *>(counters), len, region + sizeof(hdr)))
+    goto EXIT;
+  if (hdr.sum != wear_checksum(reinterpret_cast<uint8_t *>(counters), len, WEAR_SUM_SEED))
+    goto EXIT;
+  ret = OSAL_SUCCESS;
+
+EXIT:
+  if (OSAL_SUCCESS != ret)
+    memset(counters, 0, len);
+  osalSysLock();
+  wear = counters;
+  osalSysUnlock();
+  return ret;
+}
+
+/**
+ * @brief   Writes counters to reserved region.
+ * @details Counters go first, then checksum of data actually stored
+ *          on device is written in header. Interrupted save leaves
+ *          region with bad checksum, so stale counters never mix
+ *          with new ones.
+ */
+bool MtdBase::wear_save(void) {
+  mtd_wear_hdr_t hdr;
+  uint8_t chunk[64];
+  const size_t len = wear_blocks * sizeof(uint32_t);
+  const uint32_t data = wear_region + sizeof(hdr);
+  bool ret = OSAL_FAILED;
+
+  osalDbgCheck(nullptr != wear);
+
+  osalSysLock();
+  if ((MTD_WEAR_NO_REGION == wear_region) || wear_saving) {
+    osalSysUnlock();
+    return OSAL_FAILED;
+  }
+  wear_saving = true;
+  wear_unsaved = 0;
+  osalSysUnlock();
+
+  if (len != write(reinterpret_cast<const uint8_t *>(wear), len, data))
+    goto EXIT;
+  hdr.sum = WEAR_SUM_SEED;
+  if (len != read_stream(chunk, sizeof(chunk), len, data, wear_sum_cb, &hdr.sum))
+    goto EXIT;
+  hdr.magic = WEAR_MAGIC;
+  hdr.blocks = wear_blocks;
+  if (sizeof(hdr) != write(reinterpret_cast<const uint8_t *>(&hdr), sizeof(hdr), wear_region))
+    goto EXIT;
+  ret = OSAL_SUCCESS;
+
+EXIT:
+  osalSysLock();
+  wear_saving = false;
+  osalSysUnlock();
+  return ret;
+}
+
+/**
+ * @brief   Most programmed blocks, hottest first.
+ * @note    Counters are read without lock, result is approximate
+ *          while writes are in progress.
+ */
+size_t MtdBase::wear_hottest(mtd_wear_t *dst, size_t max) {
+  osalDbgCheck(nullptr != wear);
+  return nvram::wear_hottest(wear, wear_blocks, dst, max);
+}
+
+/**
+ * @brief   Prints MTD_WEAR_DUMP_TOP hottest blocks.
+ */
+void MtdBase::wear_dump(BaseSequentialStream *chp) {
+  mtd_wear_t hot[MTD_WEAR_DUMP_TOP];
+
+  wear_print(chp, hot, wear_hottest(hot, MTD_WEAR_DUMP_TOP), wear_blocksize());
+}
+
+/**
+ * @brief   Accounting granularity: page for EEPROM,
+ *          MTD_WEAR_FRAM_BLOCK_SIZE for FRAM.
+ */
+uint32_t MtdBase::wear_blocksize(void) {
+  return (1 == cfg.pages) ? MTD_WEAR_FRAM_BLOCK_SIZE : cfg.pagesize;
+}
+#endif /* MTD_USE_WEAR */
+
+/**
+ * @brief   Measures real page program time and derives operational
+ *          one with MTD_CALIB_MARGIN percents margin.
+ * @details First byte of scratch page is read and programmed back
+ *          MTD_CALIB_ROUNDS times with driver sleep disabled, so
+ *          every measurement ends by ready polling. Single byte keeps
+ *          bus transfer time out of measurement, internal write cycle
+ *          does not depend on length. Measurement is done in system
+ *          ticks, samples shorter than MTD_CALIB_MIN_TICKS are dropped.
+ *          Result never exceeds MtdConfig::programtime. Does nothing
+ *          for FRAM.
+ * @note    Every round wears scratch page.
+ * @note    Fails keeping previous result if no sample was long enough
+ *          to be measured with system tick resolution.
+ *
+ * @param[in] scratch   page aligned offset of scratch page
+ */
+bool MtdBase::calibrate(uint32_t scratch) {
+  MtdCalib tmp;
+  const size_t L = 1;
+  uint8_t *payload;
+  uint64_t sum = 0;
+  systime_t min = ~(systime_t)0;
+  systime_t max = 0;
+  bool ret = OSAL_FAILED;
+
+  if (is_fram())
+    return OSAL_SUCCESS;
+
+  osalDbgCheck((nullptr != writebuf) && (0 == (scratch % cfg.pagesize)));
+  osalDbgAssert(scratch < capacity(), "Scratch page out of device bounds");
+
+  memset(&tmp, 0, sizeof(tmp));
+
+  this->acquire();
+  payload = &writebuf[preamble_len()];
+  if (L != chunked_read(payload, L, scratch))
+    goto EXIT;
+
+  programtime = 0;
+  for (size_t i=0; i<MTD_CALIB_ROUNDS; i++) {
+    const uint32_t tb = bus_begin(MTD_OP_WRITE, scratch, L);
+    const systime_t t0 = chVTGetSystemTimeX();
+    /* payload is in place, driver only prepends preamble */
+    const size_t got = bus_write(payload, L, scratch);
+    const systime_t dt = chVTGetSystemTimeX() - t0;
+    bus_done(MTD_OP_WRITE, scratch, L, got, tb);
+    wear_account(L, scratch);
+    if (L != got)
+      goto EXIT;
+    if (dt < MTD_CALIB_MIN_TICKS)
+      continue;
+    if (dt < min)
+      min = dt;
+    if (dt > max)
+      max = dt;
+    sum += dt;
+    tmp.samples++;
+  }
+
+  if (0 == tmp.samples)
+    goto EXIT;
+
+  tmp.program_min_us = calib_ticks2us(min);
+  tmp.program_max_us = calib_ticks2us(max);
+  tmp.program_avg_us = calib_ticks2us(sum / tmp.samples);
+  tmp.programtime = ((uint64_t)max * (100 + MTD_CALIB_MARGIN) + 99) / 100;
+  if (tmp.programtime > cfg.programtime)
+    tmp.programtime = cfg.programtime;
+  ret = OSAL_SUCCESS;
+
+EXIT:
+  if (OSAL_SUCCESS == ret) {
+    osalSysLock();
+    calib = tmp;
+    osalSysUnlock();
+  }
+  programtime = calib.programtime;
+  this->release();
+  return ret;
+}
+
+/**
+ * @brief   Latest calibration result. Before calibration it holds
+ *          MtdConfig::programtime and zero samples.
+ */
+void MtdBase::calib_get(MtdCalib *dst) {
+  osalSysLock();
+  *dst = calib;
+  osalSysUnlock();
+}
+
 /**
  *
  */
@@ -25,19 +25,120 @@
 #include "hal.h"
 
 #include "mtd_conf.h"
+#include "mtd_stats.hpp"
+#include "mtd_trace.hpp"
+#include "mtd_wear.hpp"
 
 #if !defined(MTD_USE_MUTUAL_EXCLUSION)
 #define MTD_USE_MUTUAL_EXCLUSION                FALSE
 #endif
 
+/**
+ * @brief   Enables device power management: sleep after idle time
+ *          and automatic wake on next bus transaction.
+ */
+#if !defined(MTD_USE_POWER)
+#define MTD_USE_POWER                           FALSE
+#endif
+
+/**
+ * @brief   Ranges in read_batch() separated by smaller gap are merged
+ *          into single sequential read.
+ */
+#if !defined(MTD_READ_BATCH_GAP)
+#define MTD_READ_BATCH_GAP                      16
+#endif
+
+/**
+ * @brief   Longest single bus read. Limited by DMA transfer counter.
+ */
+#if !defined(MTD_BUS_READ_MAX)
+#define MTD_BUS_READ_MAX                        65535
+#endif
+
+/**
+ * @brief   Longest single burst write. Limited by DMA transfer counter.
+ */
+#if !defined(MTD_BUS_WRITE_MAX)
+#define MTD_BUS_WRITE_MAX                       65535
+#endif
+
+/**
+ * @brief   Default number of bus writes after which long write lets
+ *          waiting threads in. 0 holds lock for whole top level write,
+ *          so it is atomic for other users of the same MTD.
+ */
+#if !defined(MTD_WRITE_YIELD_PAGES)
+#define MTD_WRITE_YIELD_PAGES                   0
+#endif
+
+/**
+ * @brief   Page programs measured by calibrate().
+ */
+#if !defined(MTD_CALIB_ROUNDS)
+#define MTD_CALIB_ROUNDS                        4
+#endif
+
+/**
+ * @brief   Safety margin added to measured program time, percents.
+ */
+#if !defined(MTD_CALIB_MARGIN)
+#define MTD_CALIB_MARGIN                        25
+#endif
+
+/**
+ * @brief   Shortest accepted program time measurement, system ticks.
+ * @details Shorter samples are dominated by tick quantization and
+ *          dropped. Default keeps quantization error within 10%.
+ */
+#if !defined(MTD_CALIB_MIN_TICKS)
+#define MTD_CALIB_MIN_TICKS                     10
+#endif
+
 namespace nvram {
 
 class MtdBase; /* forward declaration */
 
 typedef void (*mtdcb_t)(MtdBase *mtd);
 
+typedef void (*mtdpowercb_t)(MtdBase *mtd, bool on);
+
+/**
+ * @brief   Kind of profiling event.
+ */
+enum mtd_event_type_t {
+  MTD_EVENT_OP_BEGIN = 0,   /* top level call entered */
+  MTD_EVENT_OP_END,
+  MTD_EVENT_BUS_BEGIN,      /* single bus transaction */
+  MTD_EVENT_BUS_END,
+};
+
+/**
+ * @brief   Context of profiling event.
+ * @note    read_stream() stopped by consumer reports streamed bytes as
+ *          'len' in its END event, stop is not a failure.
+ */
+struct mtd_event_t {
+  mtd_event_type_t  type;
+  mtd_op_t          op;
+  uint32_t          offset;
+  uint32_t          len;      /* requested bytes, see note */
+  uint32_t          done;     /* transferred bytes, 0 in BEGIN events */
+  bool              status;   /* OSAL_SUCCESS if done == len, END events only */
+  uint32_t          t_begin;  /* MTD_STATS_TIMESTAMP() units */
+  uint32_t          t_end;    /* equals t_begin in BEGIN events, see
+                                 MTD_STATS_ELAPSED_US() */
+};
+
+typedef void (*mtdeventcb_t)(MtdBase *mtd, const mtd_event_t *ev);
+
 typedef void (*spiselect_t)(void);
 
+/**
+ * @brief   Consumer of streamed data. Return OSAL_FAILED to stop stream.
+ */
+typedef bool (*mtdstreamcb_t)(const uint8_t *data, size_t len, void *arg);
+
 /**
  *
  */
@@ -86,29 +187,180 @@ struct MtdConfig {
   mtdcb_t       hook_stop_read;
   mtdcb_t       hook_start_erase;
   mtdcb_t       hook_stop_erase;
+  /**
+   * @brief   Profiling hook with operation context. Called on begin and
+   *          end of every top level call and every bus transaction.
+   *          Set to nullptr if unused.
+   * @note    Bus events are called with device lock held.
+   */
+  mtdeventcb_t  hook_event;
+  /**
+   * @brief   Power rail switch, called with device lock held. Set to
+   *          nullptr if rail is not switchable. S25 uses deep
+   *          power-down command when it is nullptr.
+   */
+  mtdpowercb_t  hook_power;
+  /**
+   * @brief   Time from power up (or deep power-down release) until
+   *          device accepts commands.
+   * @note    It is system ticks NOT milliseconds.
+   */
+  systime_t     wakeuptime;
+  /**
+   * @brief   Idle time after which power manager puts device to sleep.
+   *          Set it to 0 to disable auto sleep.
+   * @note    It is system ticks NOT milliseconds.
+   */
+  systime_t     idletime;
+};
+
+/**
+ * @brief   Result of program time calibration.
+ */
+struct MtdCalib {
+  uint32_t      samples;
+  uint32_t      program_min_us;
+  uint32_t      program_max_us;
+  uint32_t      program_avg_us;
+  /**
+   * @brief   Operational program time derived from measurements.
+   */
+  systime_t     programtime;
+};
+
+/**
+ * @brief   Single element of scatter-gather list.
+ */
+struct iovec_t {
+  void          *base;
+  size_t        len;
+};
+
+/**
+ * @brief   Single element of batched read.
+ */
+struct read_range_t {
+  uint8_t       *buf;
+  size_t        len;
+  uint32_t      offset;
 };
 
 /**
  *
  */
 class MtdBase {
+  friend class MtdShadow;
 public:
   MtdBase(const MtdConfig &cfg, uint8_t *writebuf, size_t writebuf_size);
   size_t write(const uint8_t *txdata, size_t len, uint32_t offset);
   size_t read(uint8_t *rxbuf, size_t len, uint32_t offset);
+  size_t writev(const iovec_t *iov, size_t iovcnt, uint32_t offset);
+  size_t readv(const iovec_t *iov, size_t iovcnt, uint32_t offset);
+  size_t read_batch(read_range_t *ranges, size_t cnt);
+  size_t read_stream(uint8_t *chunkbuf, size_t chunklen, size_t len,
+                     uint32_t offset, mtdstreamcb_t cb, void *arg);
+  size_t copy(uint32_t src, uint32_t dst, size_t len,
+              uint8_t *buf = nullptr, size_t buflen = 0);
+  size_t fill(uint32_t offset, size_t len, uint8_t pattern);
+  size_t erase(uint32_t offset, size_t len);
+  bool is_blank(uint32_t offset, size_t len);
+  size_t compare(uint32_t offset, const uint8_t *data, size_t len);
   uint32_t capacity(void) {return cfg.pages * cfg.pagesize;}
   uint32_t pagesize(void) {return cfg.pagesize;}
   uint32_t pagecount(void) {return cfg.pages;}
+  /**
+   * @brief   Size of sector erased by single command, 0 if device
+   *          has no erase command.
+   */
+  virtual uint32_t erasesize(void) {return 0;}
   bool is_fram(void);
+  uint32_t bus_transactions(void) {return bus_cnt;}
+  bool calibrate(uint32_t scratch);
+  void calib_get(MtdCalib *dst);
+  systime_t get_programtime(void) {return programtime;}
+  void set_write_yield(size_t pages) {yield_pages = pages;}
+#if MTD_USE_STATS
+  void stats_get(MtdStats *dst);
+  void stats_reset(void);
+#endif
+#if MTD_USE_TRACE
+  size_t trace_get(mtd_trace_t *dst, size_t max);
+  void trace_dump(BaseSequentialStream *chp);
+#endif
+#if MTD_USE_POWER
+  bool power_down(void);
+  systime_t power_idle(void);
+  void start_power_manager(void *wsp, size_t size, tprio_t prio);
+  bool is_awake(void) {return awake;}
+  void defer_start(uint8_t *pool, size_t size, systime_t window);
+  size_t write_deferred(const uint8_t *data, size_t len, uint32_t offset);
+  bool defer_flush(void);
+  size_t deferred(void) {return defer_used;}
+#endif
+#if MTD_USE_WEAR
+  bool wear_start(uint32_t *counters, size_t blocks, uint32_t region);
+  bool wear_save(void);
+  size_t wear_hottest(mtd_wear_t *dst, size_t max);
+  void wear_dump(BaseSequentialStream *chp);
+  uint32_t wear_blocksize(void);
+#endif
 protected:
   virtual size_t bus_write(const uint8_t *txdata, size_t len, uint32_t offset) = 0;
   virtual size_t bus_read(uint8_t *rxbuf, size_t len, uint32_t offset) = 0;
+  virtual size_t preamble_len(void) {return cfg.addr_len;}
+  virtual bool bus_wait_ready(systime_t timeout);
+  virtual bool bus_erase_sector(uint32_t offset);
+  virtual bool bus_power(bool on);
+  /**
+   * @brief   Longest write driver can send as single transaction with
+   *          preamble and payload in separate DMA segments. 0 if not
+   *          supported. Only FRAM may return non zero.
+   */
+  virtual size_t burst_max(void) {return 0;}
+  virtual size_t bus_write_burst(const uint8_t *txdata, size_t len,
+                                 uint32_t offset);
 
   size_t split_by_buffer(const uint8_t *txdata, size_t len, uint32_t offset);
   size_t split_by_page  (const uint8_t *txdata, size_t len, uint32_t offset);
   size_t fitted_write(const uint8_t *txdata, size_t len, uint32_t offset);
+  size_t burst_write(const uint8_t *txdata, size_t len, uint32_t offset);
+  bool write_split(size_t len, uint32_t offset);
+  void write_yield(void);
+  size_t gather_len(size_t len, uint32_t offset);
+  uint32_t bus_begin(mtd_op_t op, uint32_t offset, size_t len);
+  void bus_done(mtd_op_t op, uint32_t offset, size_t req, size_t got,
+                uint32_t t0);
+  uint32_t op_begin(mtd_op_t op, uint32_t offset, size_t len);
+  void op_end(mtd_op_t op, uint32_t offset, size_t req, size_t done,
+              uint32_t t0, bool split);
+  size_t chunked_read(uint8_t *rxbuf, size_t len, uint32_t offset);
+  size_t merged_read(read_range_t *ranges, size_t cnt);
+  size_t gathered_write(const iovec_t *iov, size_t iovcnt, size_t total,
+                        uint32_t offset);
+  size_t copy_chunk(uint8_t *buf, size_t L, uint32_t src, uint32_t dst);
+  size_t copy_buffered(uint8_t *buf, size_t buflen, uint32_t src,
+                       uint32_t dst, size_t len, bool backward);
+  size_t matched_read(uint8_t *buf, size_t room, uint32_t offset, size_t len,
+                      const uint8_t *ref, uint8_t pattern);
+  uint8_t *scratch(uint8_t *bounce, size_t *room);
+  size_t match_op(uint32_t offset, size_t len, const uint8_t *ref,
+                  uint8_t pattern);
+  bool sector_erase(uint32_t offset);
+  size_t filled_write(uint8_t *buf, size_t room, uint32_t offset, size_t len,
+                      uint8_t pattern);
+  size_t fill_op(mtd_op_t op, uint32_t offset, size_t len, uint8_t pattern);
+  void event(mtd_event_type_t type, mtd_op_t op, uint32_t offset,
+             size_t len, size_t done, uint32_t t0);
+  void wear_account(size_t len, uint32_t offset);
+  void wear_tick(void);
+#if MTD_USE_POWER
+  void power_up(void);
+  bool defer_drain(void);
+  static void power_manager(void *arg);
+#endif
 
   void addr2buf(uint8_t *buf, uint32_t addr, size_t addr_len);
+  void lock(void);
   void acquire(void);
   void release(void);
 
@@ -123,6 +375,48 @@ protected:
   const MtdConfig &cfg;
   uint8_t *writebuf;
   size_t writebuf_size;
+  /**
+   * @brief   Bus transactions issued since start. Wraps around.
+   */
+  uint32_t bus_cnt;
+  /**
+   * @brief   Time driver sleeps after page program before polling
+   *          device. Starts from MtdConfig::programtime.
+   */
+  systime_t programtime;
+  MtdCalib calib;
+  /**
+   * @brief   Fairness knob, see MTD_WRITE_YIELD_PAGES.
+   */
+  size_t yield_pages;
+  size_t burst; /* bus writes since lock was taken */
+#if MTD_USE_STATS
+  MtdStats stats;
+#endif
+#if MTD_USE_TRACE
+  mtd_trace_t trace[MTD_TRACE_DEPTH];
+  uint32_t trace_head; /* total records written, wraps around */
+#endif
+#if MTD_USE_POWER
+  bool awake;
+  systime_t last_busy; /* end of last bus transaction */
+  /**
+   * @brief   Queue of deferred writes: header followed by payload,
+   *          see write_deferred().
+   */
+  uint8_t *defer_pool;
+  size_t defer_size;
+  size_t defer_used;
+  systime_t defer_window;
+  systime_t defer_since; /* when oldest queued write arrived */
+#endif
+#if MTD_USE_WEAR
+  uint32_t *wear;
+  size_t wear_blocks;
+  uint32_t wear_region;
+  uint32_t wear_unsaved; /* programs since last save */
+  bool wear_saving;
+#endif
 };
 
 } /* namespace */
@@ -0,0 +1,178 @@
+/*
+    Abstraction layer for EEPROM ICs.
+
+    Copyright (C) 2012..2016 Uladzimir Pylinski aka barthess
+
+    This file is part of 24AA lib.
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#ifndef MTD_BASE_T_HPP_
+#define MTD_BASE_T_HPP_
+
+#include "ch.hpp"
+#include "hal.h"
+
+#include "mtd_conf.h"
+#include "mtd_base.hpp"
+
+namespace nvram {
+
+/**
+ * @brief   Compile time specialized MTD front end.
+ * @details Geometry is baked into template, so page splitting and
+ *          address packing fold into straight line code and bus
+ *          functions of Derived are called without virtual dispatch.
+ *          Derived must provide:
+ *            size_t bus_write(const uint8_t *txdata, size_t len, uint32_t offset);
+ *            size_t bus_read(uint8_t *rxbuf, size_t len, uint32_t offset);
+ * @note    It is lean alternative to MtdBase: no statistics, trace,
+ *          wear accounting, hooks or calibration. It can not be used
+ *          by Fs, which works with MtdBase.
+ *
+ * @tparam PageSize page size in bytes, whole array size for FRAM
+ * @tparam Pages    page count, 1 for FRAM
+ * @tparam AddrLen  address length in bytes
+ * @tparam Payload  longest data part of single bus write
+ */
+template <typename Derived, uint32_t PageSize, uint32_t Pages,
+          size_t AddrLen, size_t Payload>
+class MtdBaseT {
+  static_assert((AddrLen >= 1) && (AddrLen <= 4), "Incorrect address length");
+  static_assert((0 != PageSize) && (0 != Pages) && (0 != Payload), "Empty geometry");
+  static_assert((1 == Pages) || (Payload <= PageSize), "Payload exceeds page");
+public:
+  static const uint32_t CAPACITY = PageSize * Pages;
+
+  uint32_t capacity(void) {return CAPACITY;}
+  uint32_t pagesize(void) {return PageSize;}
+  uint32_t pagecount(void) {return Pages;}
+  bool is_fram(void) {return 1 == Pages;}
+
+  /**
+   * @brief   Lock is taken once for whole write like in MtdBase.
+   * @return  number of written bytes
+   */
+  size_t write(const uint8_t *txdata, size_t len, uint32_t offset) {
+    size_t written = 0;
+
+    osalDbgAssert((offset + len) <= CAPACITY, "Transaction out of device bounds");
+
+    this->acquire();
+    while (written < len) {
+      size_t L = chunk(offset);
+      if (L > (len - written))
+        L = len - written;
+
+      if (L != derived()->bus_write(txdata, L, offset))
+        break;
+      written += L;
+      txdata += L;
+      offset += L;
+    }
+    this->release();
+
+    return written;
+  }
+
+  /**
+   * @return  number of read bytes
+   */
+  size_t read(uint8_t *rxbuf, size_t len, uint32_t offset) {
+    size_t ret = 0;
+
+    osalDbgAssert((offset + len) <= CAPACITY, "Transaction out of device bounds");
+
+    this->acquire();
+    while (ret < len) {
+      size_t L = len - ret;
+      if (L > MTD_BUS_READ_MAX)
+        L = MTD_BUS_READ_MAX;
+      if (L != derived()->bus_read(&rxbuf[ret], L, offset + ret))
+        break;
+      ret += L;
+    }
+    this->release();
+
+    return ret;
+  }
+
+protected:
+  MtdBaseT(void)
+#if (MTD_USE_MUTUAL_EXCLUSION && !CH_CFG_USE_MUTEXES)
+  : semaphore(true)
+#endif
+  {
+    return;
+  }
+
+  /**
+   * @brief   Big endian address packing unrolled by compiler.
+   */
+  static void addr2buf(uint8_t *buf, uint32_t addr) {
+    for (size_t i=0; i<AddrLen; i++)
+      buf[i] = (addr >> (8 * (AddrLen - 1 - i))) & 0xFF;
+  }
+
+  /**
+   * @brief   Longest write starting at offset: bounded by page
+   *          boundary (EEPROM) and by Payload.
+   */
+  static size_t chunk(uint32_t offset) {
+    size_t L = Payload;
+
+    if (Pages > 1) {
+      const size_t tail = PageSize - (offset % PageSize);
+      if (L > tail)
+        L = tail;
+    }
+
+    return L;
+  }
+
+  void acquire(void) {
+#if MTD_USE_MUTUAL_EXCLUSION
+  #if CH_CFG_USE_MUTEXES
+    mutex.lock();
+  #elif CH_CFG_USE_SEMAPHORES
+    semaphore.wait();
+  #endif
+#endif /* MTD_USE_MUTUAL_EXCLUSION */
+  }
+
+  void release(void) {
+#if MTD_USE_MUTUAL_EXCLUSION
+  #if CH_CFG_USE_MUTEXES
+    mutex.unlock();
+  #elif CH_CFG_USE_SEMAPHORES
+    semaphore.signal();
+  #endif
+#endif /* MTD_USE_MUTUAL_EXCLUSION */
+  }
+
+private:
+  Derived *derived(void) {return static_cast<Derived *>(this);}
+
+  #if MTD_USE_MUTUAL_EXCLUSION
+    #if CH_CFG_USE_MUTEXES
+      chibios_rt::Mutex             mutex;
+    #elif CH_CFG_USE_SEMAPHORES
+      chibios_rt::CounterSemaphore  semaphore;
+    #endif
+  #endif /* MTD_USE_MUTUAL_EXCLUSION */
+};
+
+} /* namespace */
+
+#endif /* MTD_BASE_T_HPP_ */
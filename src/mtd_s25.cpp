@@ -23,7 +23,7 @@
 
 #include "ch.hpp"
 
-#include "mtd25.hpp"
+#include "mtd_s25.hpp"
 
 namespace nvram {
 
@@ -37,6 +37,8 @@ namespace nvram {
 #define     S25_CMD_PP      0x02  // page program
 #define     S25_CMD_4PP     0x12
 #define     S25_CMD_BE      0x60  // bulk erase
+#define     S25_CMD_SE      0xD8  // sector erase
+#define     S25_CMD_4SE     0xDC
 #define     S25_CMD_RDSR1   0x05  // Read Status Register-1
 #define     S25_CMD_RDSR2   0x07  // Read Status Register-2
 #define     S25_CMD_RDCR    0x35  // Read Configuration Register-1
@@ -45,6 +47,8 @@ namespace nvram {
 #define     S25_CMD_WRDI    0x04  // Write Disable
 #define     S25_CMD_WREN    0x06  // Write Enable
 #define     S25_CMD_CLSR    0x30  // Clear Status Register-1 - Erase/Prog. Fail Reset
+#define     S25_CMD_DP      0xB9  // Deep Power-Down
+#define     S25_CMD_RES     0xAB  // Release from Deep Power-Down
 
 #define     S25_SR1_WEL     0b00000010  // write enable latch (1 == write enable)
 #define     S25_SR1_PERR    0b01000000  // program error (0 - ok, 1 - error)
@@ -79,8 +83,8 @@ namespace nvram {
 /**
  *
  */
-msg_t Mtd25::spi_read(uint8_t *rxbuf, size_t len,
-                      uint8_t *writebuf, size_t preamble_len) {
+msg_t MtdS25::spi_read(uint8_t *rxbuf, size_t len,
+                       uint8_t *writebuf, size_t preamble_len) {
 
 #if SPI_USE_MUTUAL_EXCLUSION
   spiAcquireBus(this->spip);
@@ -103,7 +107,7 @@ msg_t Mtd25::spi_read(uint8_t *rxbuf, size_t len,
 /**
  *
  */
-msg_t Mtd25::spi_write_enable(void) {
+msg_t MtdS25::spi_write_enable(void) {
   msg_t ret = MSG_RESET;
   uint8_t tmp;
 
@@ -137,10 +141,11 @@ msg_t Mtd25::spi_write_enable(void) {
 /**
  *
  */
-msg_t Mtd25::spi_write(const uint8_t *txdata, size_t len,
-                       uint8_t *writebuf, size_t preamble_len) {
+msg_t MtdS25::spi_write(const uint8_t *txdata, size_t len,
+                        uint8_t *writebuf, size_t preamble_len) {
 
-  if ((nullptr != txdata) && (len > 0)) {
+  /* data may be already gathered in place by MtdBase::writev() */
+  if ((nullptr != txdata) && (len > 0) && (txdata != &writebuf[preamble_len])) {
     memcpy(&writebuf[preamble_len], txdata, len);
   }
 
@@ -160,13 +165,21 @@ msg_t Mtd25::spi_write(const uint8_t *txdata, size_t len,
   spiReleaseBus(this->spip);
 #endif
 
-  return wait_op_complete(cfg.programtime);
+  /* page program takes hundreds of microseconds, poll it after
+   * operational program time instead of coarse erase style wait */
+  if (0 != programtime)
+    osalThreadSleep(programtime);
+
+  if (OSAL_SUCCESS == bus_wait_ready(cfg.programtime))
+    return MSG_OK;
+  else
+    return MSG_RESET;
 }
 
 /**
  *
  */
-msg_t Mtd25::wait_op_complete(systime_t timeout) {
+msg_t MtdS25::wait_op_complete(systime_t timeout) {
 
   systime_t start = chVTGetSystemTimeX();
   systime_t end = start + timeout;
@@ -206,18 +219,56 @@ msg_t Mtd25::wait_op_complete(systime_t timeout) {
   return MSG_RESET;
 }
 
+/**
+ * @brief   Polls WIP bit of status register back to back.
+ * @return  OSAL_FAILED on timeout or program/erase error.
+ */
+bool MtdS25::bus_wait_ready(systime_t timeout) {
+  const systime_t start = chVTGetSystemTimeX();
+  uint8_t tmp;
+
+  do {
+#if SPI_USE_MUTUAL_EXCLUSION
+    spiAcquireBus(this->spip);
+#endif
+
+    spiSelect(spip);
+    spiPolledExchange(spip, S25_CMD_RDSR1);
+    tmp = spiPolledExchange(spip, 0);
+    spiUnselect(spip);
+
+#if SPI_USE_MUTUAL_EXCLUSION
+    spiReleaseBus(this->spip);
+#endif
+
+    if (0 == (tmp & S25_SR1_WIP)) {
+      if (tmp & (S25_SR1_PERR | S25_SR1_EERR))
+        return OSAL_FAILED;
+      else
+        return OSAL_SUCCESS;
+    }
+  } while (chVTIsSystemTimeWithinX(start, start + timeout + 1));
+
+  return OSAL_FAILED;
+}
+
+/**
+ * @brief   Command byte followed by address.
+ */
+size_t MtdS25::preamble_len(void) {
+  return 1 + cfg.addr_len;
+}
+
 /**
  * @brief   Accepts data that can be fitted in single page boundary (for EEPROM)
  *          or can be placed in write buffer (for FRAM)
  */
-size_t Mtd25::bus_write(const uint8_t *txdata, size_t len, uint32_t offset) {
+size_t MtdS25::bus_write(const uint8_t *txdata, size_t len, uint32_t offset) {
   msg_t status;
 
   osalDbgCheck(this->writebuf_size >= cfg.pagesize + cfg.addr_len + 1);
   osalDbgAssert((offset + len) <= capacity(), "Transaction out of device bounds");
 
-  this->acquire();
-
   /* fill preamble */
   if (4 == cfg.addr_len)
     writebuf[0] = S25_CMD_4PP;
@@ -227,8 +278,6 @@ size_t Mtd25::bus_write(const uint8_t *txdata, size_t len, uint32_t offset) {
 
   status = spi_write(txdata, len, writebuf, 1+cfg.addr_len);
 
-  this->release();
-
   if (MSG_OK == status)
     return len;
   else
@@ -238,14 +287,12 @@ size_t Mtd25::bus_write(const uint8_t *txdata, size_t len, uint32_t offset) {
 /**
  *
  */
-size_t Mtd25::bus_read(uint8_t *rxbuf, size_t len, uint32_t offset) {
+size_t MtdS25::bus_read(uint8_t *rxbuf, size_t len, uint32_t offset) {
   msg_t status;
 
   osalDbgAssert((offset + len) <= capacity(), "Transaction out of device bounds");
   osalDbgCheck(this->writebuf_size >= cfg.addr_len + 1);
 
-  this->acquire();
-
   /* fill preamble */
   if (4 == cfg.addr_len)
     writebuf[0] = S25_CMD_4READ;
@@ -255,8 +302,6 @@ size_t Mtd25::bus_read(uint8_t *rxbuf, size_t len, uint32_t offset) {
 
   status = spi_read(rxbuf, len, writebuf, 1+cfg.addr_len);
 
-  this->release();
-
   if (MSG_OK == status)
     return len;
   else
@@ -266,7 +311,7 @@ size_t Mtd25::bus_read(uint8_t *rxbuf, size_t len, uint32_t offset) {
 /**
  *
  */
-msg_t Mtd25::bus_erase(void) {
+msg_t MtdS25::bus_erase(void) {
   msg_t ret;
 
   this->acquire();
@@ -280,6 +325,68 @@ msg_t Mtd25::bus_erase(void) {
   return ret;
 }
 
+/**
+ * @brief   Erases sector containing offset.
+ * @note    Called with lock held.
+ * @return  OSAL_FAILED on timeout or erase error.
+ */
+bool MtdS25::bus_erase_sector(uint32_t offset) {
+
+  if (4 == cfg.addr_len)
+    writebuf[0] = S25_CMD_4SE;
+  else
+    writebuf[0] = S25_CMD_SE;
+  addr2buf(&writebuf[1], offset, cfg.addr_len);
+
+  if (MSG_OK != spi_write_enable())
+    return OSAL_FAILED;
+
+#if SPI_USE_MUTUAL_EXCLUSION
+  spiAcquireBus(this->spip);
+#endif
+
+  spiSelect(spip);
+  spiSend(spip, 1 + cfg.addr_len, writebuf);
+  spiUnselect(spip);
+
+#if SPI_USE_MUTUAL_EXCLUSION
+  spiReleaseBus(this->spip);
+#endif
+
+  if (MSG_OK == wait_op_complete(cfg.erasetime))
+    return OSAL_SUCCESS;
+  else
+    return OSAL_FAILED;
+}
+
+/**
+ * @brief   Deep power-down command unless power rail is switchable.
+ * @note    Called with lock held.
+ */
+bool MtdS25::bus_power(bool on) {
+
+  if (nullptr != cfg.hook_power)
+    return MtdBase::bus_power(on);
+
+#if SPI_USE_MUTUAL_EXCLUSION
+  spiAcquireBus(this->spip);
+#endif
+
+  spiSelect(spip);
+  spiPolledExchange(spip, on ? S25_CMD_RES : S25_CMD_DP);
+  spiUnselect(spip);
+
+#if SPI_USE_MUTUAL_EXCLUSION
+  spiReleaseBus(this->spip);
+#endif
+
+  /* tRES */
+  if (on && (0 != cfg.wakeuptime))
+    osalThreadSleep(cfg.wakeuptime);
+
+  return OSAL_SUCCESS;
+}
+
 /*
  ******************************************************************************
  * EXPORTED FUNCTIONS
@@ -289,8 +396,8 @@ msg_t Mtd25::bus_erase(void) {
 /**
  *
  */
-Mtd25::Mtd25(const MtdConfig &cfg, uint8_t *writebuf, size_t writebuf_size, SPIDriver *spip) :
-Mtd(cfg, writebuf, writebuf_size),
+MtdS25::MtdS25(const MtdConfig &cfg, uint8_t *writebuf, size_t writebuf_size, SPIDriver *spip) :
+MtdBase(cfg, writebuf, writebuf_size),
 spip(spip)
 {
   return;
@@ -18,27 +18,39 @@
     limitations under the License.
 */
 
-#ifndef MTD25_HPP_
-#define MTD25_HPP_
+#ifndef MTD_S25_HPP_
+#define MTD_S25_HPP_
 
 #include "ch.hpp"
 #include "hal.h"
 
 #include "mtd_conf.h"
-#include "mtd.hpp"
+#include "mtd_base.hpp"
+
+/**
+ * @brief   Size of sector erased by SE command. 256 kB for S25FL512S.
+ */
+#if !defined(MTD_S25_SECTOR_SIZE)
+#define MTD_S25_SECTOR_SIZE                     (256 * 1024)
+#endif
 
 namespace nvram {
 
 /**
  *
  */
-class Mtd25 : public Mtd {
+class MtdS25 : public MtdBase {
 public:
-  Mtd25(const MtdConfig &cfg, uint8_t *writebuf, size_t writebuf_size, SPIDriver *spip);
+  MtdS25(const MtdConfig &cfg, uint8_t *writebuf, size_t writebuf_size, SPIDriver *spip);
+  uint32_t erasesize(void) {return MTD_S25_SECTOR_SIZE;}
 protected:
   size_t bus_write(const uint8_t *txdata, size_t len, uint32_t offset);
   size_t bus_read(uint8_t *rxbuf, size_t len, uint32_t offset);
+  size_t preamble_len(void);
+  bool bus_wait_ready(systime_t timeout);
   msg_t bus_erase(void);
+  bool bus_erase_sector(uint32_t offset);
+  bool bus_power(bool on);
 private:
   msg_t spi_write_enable(void);
   msg_t wait_op_complete(systime_t timeout);
@@ -51,4 +63,4 @@ private:
 
 } /* namespace */
 
-#endif /* MTD24_HPP_ */
+#endif /* MTD_S25_HPP_ */
@@ -0,0 +1,247 @@
+/*
+    Abstraction layer for EEPROM ICs.
+
+    Copyright (C) 2012..2016 Uladzimir Pylinski aka barthess
+
+    This file is part of 24AA lib.
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include <cstring>
+#include <cstdlib>
+
+#include "ch.hpp"
+
+#include "mtd_shadow.hpp"
+
+namespace nvram {
+
+/*
+ ******************************************************************************
+ * DEFINES
+ ******************************************************************************
+ */
+
+/*
+ ******************************************************************************
+ * EXTERNS
+ ******************************************************************************
+ */
+
+/*
+ ******************************************************************************
+ * PROTOTYPES
+ ******************************************************************************
+ */
+
+/*
+ ******************************************************************************
+ * GLOBAL VARIABLES
+ ******************************************************************************
+ */
+
+/*
+ ******************************************************************************
+ ******************************************************************************
+ * LOCAL FUNCTIONS
+ ******************************************************************************
+ ******************************************************************************
+ */
+
+/**
+ *
+ */
+size_t MtdShadow::blocksize(void) {
+  if (cfg.pages > 1)
+    return cfg.pagesize;
+  else
+    return MTD_SHADOW_FRAM_BLOCK_SIZE;
+}
+
+/**
+ *
+ */
+void MtdShadow::mark_dirty(size_t len, uint32_t offset) {
+  const size_t bs = blocksize();
+  const size_t first = offset / bs;
+  const size_t last = (offset + len - 1) / bs;
+
+  for (size_t i=first; i<=last; i++) {
+    const uint8_t mask = 1 << (i % 8);
+    if (0 == (dirtymap[i / 8] & mask)) {
+      dirtymap[i / 8] |= mask;
+      dirty++;
+    }
+  }
+}
+
+/**
+ *
+ */
+size_t MtdShadow::bus_write(const uint8_t *txdata, size_t len, uint32_t offset) {
+  size_t ret = len;
+
+  osalDbgAssert((offset + len) <= capacity(), "Transaction out of device bounds");
+
+  memcpy(&mirror[offset], txdata, len);
+  if (writeback) {
+    mark_dirty(len, offset);
+  }
+  else {
+    if (len != backing.write(txdata, len, offset)) {
+      /* let flush() retry it later, if there is map to remember it */
+      if (nullptr != dirtymap)
+        mark_dirty(len, offset);
+      ret = 0;
+    }
+  }
+
+  return ret;
+}
+
+/**
+ *
+ */
+size_t MtdShadow::bus_read(uint8_t *rxbuf, size_t len, uint32_t offset) {
+
+  osalDbgAssert((offset + len) <= capacity(), "Transaction out of device bounds");
+  osalDbgCheck((nullptr != rxbuf) && (0 != len));
+
+  memcpy(rxbuf, &mirror[offset], len);
+
+  return len;
+}
+
+/**
+ * @brief   Mirror is RAM, backing device manages its own power.
+ */
+bool MtdShadow::bus_power(bool on) {
+  (void)on;
+  return OSAL_SUCCESS;
+}
+
+/**
+ *
+ */
+void MtdShadow::flusher(void *arg) {
+  MtdShadow *self = static_cast<MtdShadow *>(arg);
+
+  while (true) {
+    osalThreadSleep(self->flush_period);
+    self->flush();
+  }
+}
+
+/*
+ ******************************************************************************
+ * EXPORTED FUNCTIONS
+ ******************************************************************************
+ */
+
+/**
+ * @brief   Constructor.
+ *
+ * @param[in] backing   real memory device.
+ * @param[in] mirror    RAM buffer of device capacity size.
+ * @param[in] dirtymap  buffer of MTD_SHADOW_DIRTYMAP_SIZE() bytes.
+ *                      May be nullptr in write through mode, failed
+ *                      device writes are not retried by flush() then.
+ * @param[in] writeback defer device writes until flush().
+ */
+MtdShadow::MtdShadow(MtdBase &backing, uint8_t *mirror, uint8_t *dirtymap,
+                                                           bool writeback) :
+/* Mirror does not use write buffer. Its size is chosen to prevent
+ * splitting of FRAM writes. */
+MtdBase(backing.cfg, nullptr, backing.capacity() + backing.cfg.addr_len),
+backing(backing),
+mirror(mirror),
+dirtymap(dirtymap),
+writeback(writeback),
+dirty(0),
+flush_period(0)
+{
+  osalDbgCheck(nullptr != mirror);
+  osalDbgCheck(!writeback || (nullptr != dirtymap));
+}
+
+/**
+ * @brief   Load whole device into mirror.
+ */
+bool MtdShadow::start(void) {
+  const size_t cap = capacity();
+  bool ret = OSAL_SUCCESS;
+
+  this->acquire();
+  if (cap != backing.read(mirror, cap, 0))
+    ret = OSAL_FAILED;
+  if (nullptr != dirtymap)
+    memset(dirtymap, 0, MTD_SHADOW_DIRTYMAP_SIZE(cap / blocksize()));
+  dirty = 0;
+  this->release();
+
+  return ret;
+}
+
+/**
+ * @brief   Write all dirty blocks to device.
+ * @details Works as barrier: all writes completed before the call are
+ *          on device when it returns successfully.
+ */
+bool MtdShadow::flush(void) {
+  const size_t bs = blocksize();
+  const size_t blocks = capacity() / bs;
+  bool ret = OSAL_SUCCESS;
+
+  if (nullptr == dirtymap)
+    return OSAL_SUCCESS;
+
+  this->acquire();
+  for (size_t i=0; (i<blocks) && (dirty > 0); i++) {
+    const uint8_t mask = 1 << (i % 8);
+    if (0 != (dirtymap[i / 8] & mask)) {
+      if (bs == backing.write(&mirror[i * bs], bs, i * bs)) {
+        dirtymap[i / 8] &= ~mask;
+        dirty--;
+      }
+      else {
+        ret = OSAL_FAILED;
+      }
+    }
+  }
+  this->release();
+
+  return ret;
+}
+
+/**
+ * @brief   Number of blocks waiting for flush.
+ */
+size_t MtdShadow::dirty_count(void) {
+  return dirty;
+}
+
+/**
+ * @brief   Start thread flushing dirty blocks periodically.
+ * @details Deferred writes are batched: with MTD_USE_POWER sleeping
+ *          backing device wakes once per flush, not once per write.
+ */
+void MtdShadow::start_flusher(void *wsp, size_t size, tprio_t prio,
+                                                       systime_t period) {
+  osalDbgCheck(writeback && (0 != period));
+
+  flush_period = period;
+  chThdCreateStatic(wsp, size, prio, flusher, this);
+}
+
+} /* namespace */
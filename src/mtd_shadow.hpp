@@ -0,0 +1,77 @@
+/*
+    Abstraction layer for EEPROM ICs.
+
+    Copyright (C) 2012..2016 Uladzimir Pylinski aka barthess
+
+    This file is part of 24AA lib.
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#ifndef MTD_SHADOW_HPP_
+#define MTD_SHADOW_HPP_
+
+#include "ch.hpp"
+#include "hal.h"
+
+#include "mtd_conf.h"
+#include "mtd_base.hpp"
+
+/**
+ * @brief   Dirty tracking granularity for FRAM (it has no pages).
+ */
+#if !defined(MTD_SHADOW_FRAM_BLOCK_SIZE)
+#define MTD_SHADOW_FRAM_BLOCK_SIZE              64
+#endif
+
+/**
+ * @brief   Size of dirty map in bytes for given number of blocks.
+ * @note    Block is page for EEPROM and MTD_SHADOW_FRAM_BLOCK_SIZE for FRAM.
+ */
+#define MTD_SHADOW_DIRTYMAP_SIZE(blocks)        (((blocks) + 7) / 8)
+
+namespace nvram {
+
+/**
+ * @brief   RAM mirror of whole memory device.
+ * @details Reads are served from RAM. Writes go to RAM and either
+ *          synchronously to the device (write through) or only marked
+ *          in dirty map and written later by flush() (write back).
+ */
+class MtdShadow : public MtdBase {
+public:
+  MtdShadow(MtdBase &backing, uint8_t *mirror, uint8_t *dirtymap,
+                                                  bool writeback);
+  bool start(void);
+  bool flush(void);
+  size_t dirty_count(void);
+  void start_flusher(void *wsp, size_t size, tprio_t prio, systime_t period);
+protected:
+  size_t bus_write(const uint8_t *txdata, size_t len, uint32_t offset);
+  size_t bus_read(uint8_t *rxbuf, size_t len, uint32_t offset);
+  bool bus_power(bool on);
+private:
+  static void flusher(void *arg);
+  size_t blocksize(void);
+  void mark_dirty(size_t len, uint32_t offset);
+  MtdBase &backing;
+  uint8_t *mirror;
+  uint8_t *dirtymap;
+  const bool writeback;
+  size_t dirty;
+  systime_t flush_period;
+};
+
+} /* namespace */
+
+#endif /* MTD_SHADOW_HPP_ */
@@ -0,0 +1,114 @@
+/*
+    Abstraction layer for EEPROM ICs.
+
+    Copyright (C) 2012..2016 Uladzimir Pylinski aka barthess
+
+    This file is part of 24AA lib.
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include "ch.hpp"
+#include "hal.h"
+#include "chprintf.h"
+
+#include "mtd_stats.hpp"
+
+namespace nvram {
+
+/*
+ ******************************************************************************
+ * DEFINES
+ ******************************************************************************
+ */
+
+/*
+ ******************************************************************************
+ * EXTERNS
+ ******************************************************************************
+ */
+
+/*
+ ******************************************************************************
+ * PROTOTYPES
+ ******************************************************************************
+ */
+
+/*
+ ******************************************************************************
+ * GLOBAL VARIABLES
+ ******************************************************************************
+ */
+
+static const char *op_names[MTD_OP_CNT] = {
+    "read",
+    "write",
+    "erase",
+};
+
+/*
+ ******************************************************************************
+ ******************************************************************************
+ * LOCAL FUNCTIONS
+ ******************************************************************************
+ ******************************************************************************
+ */
+
+/*
+ ******************************************************************************
+ * EXPORTED FUNCTIONS
+ ******************************************************************************
+ */
+
+/**
+ * @brief   Histogram bucket for given latency.
+ */
+size_t stats_bucket(uint32_t us) {
+  size_t ret = 0;
+
+  while ((0 != us) && (ret < (MTD_STATS_BUCKETS - 1))) {
+    us >>= 1;
+    ret++;
+  }
+
+  return ret;
+}
+
+/**
+ * @brief   Prints statistics snapshot. Suitable for shell command.
+ * @details Only non empty histogram buckets are printed as
+ *          'upper_bound_us:count' pairs.
+ */
+void stats_print(BaseSequentialStream *chp, const MtdStats *st) {
+
+  for (size_t i=0; i<MTD_OP_CNT; i++) {
+    const mtd_op_stats_t *op = &st->op[i];
+    chprintf(chp, "%-6s ops=%u bytes=%u errors=%u\r\n",
+             op_names[i], op->ops, op->bytes, op->errors);
+    chprintf(chp, "       lat:");
+    for (size_t b=0; b<MTD_STATS_BUCKETS; b++) {
+      if (0 != op->hist[b]) {
+        if (b == (MTD_STATS_BUCKETS - 1))
+          chprintf(chp, " inf:%u", op->hist[b]);
+        else
+          chprintf(chp, " %u:%u", 1U << b, op->hist[b]);
+      }
+    }
+    chprintf(chp, "\r\n");
+  }
+
+  chprintf(chp, "programs=%u erases=%u splits=%u bus_errors=%u wakeups=%u\r\n",
+           st->programs, st->erases, st->splits, st->bus_errors, st->wakeups);
+}
+
+} /* namespace */
@@ -0,0 +1,121 @@
+/*
+    Abstraction layer for EEPROM ICs.
+
+    Copyright (C) 2012..2016 Uladzimir Pylinski aka barthess
+
+    This file is part of 24AA lib.
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#ifndef MTD_STATS_HPP_
+#define MTD_STATS_HPP_
+
+#include "ch.hpp"
+#include "hal.h"
+
+#include "mtd_conf.h"
+
+/**
+ * @brief   Enables per device statistics.
+ */
+#if !defined(MTD_USE_STATS)
+#define MTD_USE_STATS                           FALSE
+#endif
+
+/**
+ * @brief   Time source for latency histograms and trace.
+ * @details Returns free running counter, system ticks by default.
+ *          Do not convert absolute time here: ST2US() of raw system time
+ *          overflows 32-bit math in less than a second on slow tick.
+ */
+#if !defined(MTD_STATS_TIMESTAMP)
+#define MTD_STATS_TIMESTAMP()                   ((uint32_t)chVTGetSystemTimeX())
+#endif
+
+/**
+ * @brief   Converts difference of two MTD_STATS_TIMESTAMP() values to uS.
+ * @note    Difference is taken in systime_t first so counter wrap is
+ *          harmless, scaling uses 64-bit math. Must be overridden
+ *          together with MTD_STATS_TIMESTAMP().
+ */
+#if !defined(MTD_STATS_ELAPSED_US)
+#define MTD_STATS_ELAPSED_US(t0, t1)                                        \
+  ((uint32_t)(((uint64_t)(systime_t)((systime_t)(t1) - (systime_t)(t0)) *   \
+               1000000ULL + CH_CFG_ST_FREQUENCY - 1ULL) / CH_CFG_ST_FREQUENCY))
+#endif
+
+/**
+ * @brief   Number of log2 latency buckets.
+ * @note    Bucket N counts operations lasted [2^(N-1), 2^N) uS,
+ *          the last one collects everything longer.
+ */
+#if !defined(MTD_STATS_BUCKETS)
+#define MTD_STATS_BUCKETS                       24
+#endif
+
+namespace nvram {
+
+/**
+ *
+ */
+enum mtd_op_t {
+  MTD_OP_READ = 0,
+  MTD_OP_WRITE,
+  MTD_OP_ERASE,
+  MTD_OP_CNT,
+};
+
+/**
+ * @brief   Counters of single operation type.
+ */
+struct mtd_op_stats_t {
+  uint32_t      ops;
+  uint32_t      bytes;
+  uint32_t      errors;   /* operations completed partially */
+  uint32_t      hist[MTD_STATS_BUCKETS];
+};
+
+/**
+ * @brief   Statistics of single MTD.
+ */
+struct MtdStats {
+  mtd_op_stats_t  op[MTD_OP_CNT];
+  /**
+   * @brief   Bus write transactions (page programs for EEPROM).
+   */
+  uint32_t        programs;
+  /**
+   * @brief   Sector erase commands.
+   */
+  uint32_t        erases;
+  /**
+   * @brief   Device wakes from sleep (MTD_USE_POWER only).
+   */
+  uint32_t        wakeups;
+  /**
+   * @brief   Writes split into more than one bus transaction.
+   */
+  uint32_t        splits;
+  /**
+   * @brief   Bus transactions transferred less than requested.
+   */
+  uint32_t        bus_errors;
+};
+
+size_t stats_bucket(uint32_t us);
+void stats_print(BaseSequentialStream *chp, const MtdStats *st);
+
+} /* namespace */
+
+#endif /* MTD_STATS_HPP_ */
@@ -0,0 +1,126 @@
+/*
+    Abstraction layer for EEPROM ICs.
+
+    Copyright (C) 2012..2016 Uladzimir Pylinski aka barthess
+
+    This file is part of 24AA lib.
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include <cstdlib>
+#include <cstring>
+
+#include "ch.hpp"
+#include "hal.h"
+#include "chprintf.h"
+
+#include "mtd_stats.hpp"
+#include "mtd_trace.hpp"
+
+namespace nvram {
+
+/*
+ ******************************************************************************
+ * DEFINES
+ ******************************************************************************
+ */
+
+#define TRACE_FIELDS      7
+
+/*
+ ******************************************************************************
+ * EXTERNS
+ ******************************************************************************
+ */
+
+/*
+ ******************************************************************************
+ * PROTOTYPES
+ ******************************************************************************
+ */
+
+/*
+ ******************************************************************************
+ * GLOBAL VARIABLES
+ ******************************************************************************
+ */
+
+/*
+ ******************************************************************************
+ ******************************************************************************
+ * LOCAL FUNCTIONS
+ ******************************************************************************
+ ******************************************************************************
+ */
+
+/*
+ ******************************************************************************
+ * EXPORTED FUNCTIONS
+ ******************************************************************************
+ */
+
+/**
+ *
+ */
+void trace_print_header(BaseSequentialStream *chp) {
+  chprintf(chp, "# trace,time_us,duration_us,thread,op,offset,len,done\r\n");
+}
+
+/**
+ * @brief   Prints records as CSV lines understood by trace_parse().
+ */
+void trace_print(BaseSequentialStream *chp, const mtd_trace_t *t, size_t n) {
+  for (size_t i=0; i<n; i++) {
+    chprintf(chp, "trace,%u,%u,%x,%u,%u,%u,%u\r\n",
+             t[i].time, t[i].duration, t[i].thread, t[i].op,
+             t[i].offset, t[i].len, t[i].done);
+  }
+}
+
+/**
+ * @brief   Parses single line produced by trace_print().
+ * @return  OSAL_FAILED if line is not trace record.
+ */
+bool trace_parse(const char *line, mtd_trace_t *t) {
+  uint32_t v[TRACE_FIELDS];
+  const char *p;
+  char *end;
+
+  if (0 != strncmp(line, "trace,", 6))
+    return OSAL_FAILED;
+
+  p = line + 6;
+  for (size_t i=0; i<TRACE_FIELDS; i++) {
+    v[i] = strtoul(p, &end, (2 == i) ? 16 : 10);
+    if (end == p)
+      return OSAL_FAILED;
+    if ((i < (TRACE_FIELDS - 1)) && (',' != *end))
+      return OSAL_FAILED;
+    p = end + 1;
+  }
+
+  if (v[3] >= MTD_OP_CNT)
+    return OSAL_FAILED;
+
+  t->time     = v[0];
+  t->duration = v[1];
+  t->thread   = v[2];
+  t->op       = v[3];
+  t->offset   = v[4];
+  t->len      = v[5];
+  t->done     = v[6];
+  return OSAL_SUCCESS;
+}
+
+} /* namespace */
@@ -0,0 +1,76 @@
+/*
+    Abstraction layer for EEPROM ICs.
+
+    Copyright (C) 2012..2016 Uladzimir Pylinski aka barthess
+
+    This file is part of 24AA lib.
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#ifndef MTD_TRACE_HPP_
+#define MTD_TRACE_HPP_
+
+#include "ch.hpp"
+#include "hal.h"
+
+#include "mtd_conf.h"
+
+/**
+ * @brief   Enables trace of every top level MTD operation.
+ */
+#if !defined(MTD_USE_TRACE)
+#define MTD_USE_TRACE                           FALSE
+#endif
+
+/**
+ * @brief   Trace ring buffer depth in records. Must be power of 2.
+ * @note    Every record costs 28 bytes of RAM.
+ */
+#if !defined(MTD_TRACE_DEPTH)
+#define MTD_TRACE_DEPTH                         64
+#endif
+
+/**
+ * @brief   Identifier of calling thread stored in trace.
+ */
+#if !defined(MTD_TRACE_THREAD)
+#define MTD_TRACE_THREAD()                      ((uint32_t)(uintptr_t)chThdGetSelfX())
+#endif
+
+#if (MTD_TRACE_DEPTH & (MTD_TRACE_DEPTH - 1)) != 0
+#error "MTD_TRACE_DEPTH must be power of 2"
+#endif
+
+namespace nvram {
+
+/**
+ * @brief   Single trace record.
+ */
+struct mtd_trace_t {
+  uint32_t      time;       /* operation start, uS */
+  uint32_t      duration;   /* uS */
+  uint32_t      thread;
+  uint32_t      offset;
+  uint32_t      len;        /* requested bytes */
+  uint32_t      done;       /* transferred bytes */
+  uint32_t      op;         /* mtd_op_t */
+};
+
+void trace_print_header(BaseSequentialStream *chp);
+void trace_print(BaseSequentialStream *chp, const mtd_trace_t *t, size_t n);
+bool trace_parse(const char *line, mtd_trace_t *t);
+
+} /* namespace */
+
+#endif /* MTD_TRACE_HPP_ */
@@ -0,0 +1,124 @@
+/*
+    Abstraction layer for EEPROM ICs.
+
+    Copyright (C) 2012..2016 Uladzimir Pylinski aka barthess
+
+    This file is part of 24AA lib.
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include "ch.hpp"
+#include "hal.h"
+#include "chprintf.h"
+
+#include "mtd_wear.hpp"
+
+namespace nvram {
+
+/*
+ ******************************************************************************
+ * DEFINES
+ ******************************************************************************
+ */
+
+/*
+ ******************************************************************************
+ * EXTERNS
+ ******************************************************************************
+ */
+
+/*
+ ******************************************************************************
+ * PROTOTYPES
+ ******************************************************************************
+ */
+
+/*
+ ******************************************************************************
+ * GLOBAL VARIABLES
+ ******************************************************************************
+ */
+
+/*
+ ******************************************************************************
+ ******************************************************************************
+ * LOCAL FUNCTIONS
+ ******************************************************************************
+ ******************************************************************************
+ */
+
+/*
+ ******************************************************************************
+ * EXPORTED FUNCTIONS
+ ******************************************************************************
+ */
+
+/**
+ * @brief   Incremental FNV-1a. Start with sum = 2166136261.
+ */
+uint32_t wear_checksum(const uint8_t *data, size_t len, uint32_t sum) {
+
+  for (size_t i=0; i<len; i++) {
+    sum ^= data[i];
+    sum *= 16777619;
+  }
+
+  return sum;
+}
+
+/**
+ * @brief   Selects most programmed blocks, hottest first.
+ * @return  Number of stored entries.
+ */
+size_t wear_hottest(const uint32_t *counters, size_t blocks,
+                    mtd_wear_t *dst, size_t max) {
+  size_t n = 0;
+
+  for (size_t b=0; b<blocks; b++) {
+    const uint32_t c = counters[b];
+    size_t j;
+
+    if (0 == c)
+      continue;
+    if ((n == max) && ((0 == max) || (c <= dst[n-1].count)))
+      continue;
+
+    if (n < max)
+      n++;
+    j = n - 1;
+    while ((j > 0) && (dst[j-1].count < c)) {
+      dst[j] = dst[j-1];
+      j--;
+    }
+    dst[j].block = b;
+    dst[j].count = c;
+  }
+
+  return n;
+}
+
+/**
+ * @brief   Prints hottest blocks. Suitable for shell command.
+ */
+void wear_print(BaseSequentialStream *chp, const mtd_wear_t *hot, size_t n,
+                uint32_t blocksize) {
+
+  chprintf(chp, "wear,block,offset,programs\r\n");
+  for (size_t i=0; i<n; i++) {
+    chprintf(chp, "wear,%u,%u,%u\r\n",
+             hot[i].block, hot[i].block * blocksize, hot[i].count);
+  }
+}
+
+} /* namespace */
@@ -0,0 +1,98 @@
+/*
+    Abstraction layer for EEPROM ICs.
+
+    Copyright (C) 2012..2016 Uladzimir Pylinski aka barthess
+
+    This file is part of 24AA lib.
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#ifndef MTD_WEAR_HPP_
+#define MTD_WEAR_HPP_
+
+#include "ch.hpp"
+#include "hal.h"
+
+#include "mtd_conf.h"
+
+/**
+ * @brief   Enables per page program counters.
+ */
+#if !defined(MTD_USE_WEAR)
+#define MTD_USE_WEAR                            FALSE
+#endif
+
+/**
+ * @brief   Wear accounting granularity for FRAM (it has no pages).
+ */
+#if !defined(MTD_WEAR_FRAM_BLOCK_SIZE)
+#define MTD_WEAR_FRAM_BLOCK_SIZE                64
+#endif
+
+/**
+ * @brief   Programs between automatic saves of counters.
+ * @note    Every save programs pages of reserved region, so too small
+ *          value turns region itself into hotspot. Set to 0 to save
+ *          only by explicit wear_save() call.
+ */
+#if !defined(MTD_WEAR_SAVE_EVERY)
+#define MTD_WEAR_SAVE_EVERY                     4096
+#endif
+
+/**
+ * @brief   Number of hottest blocks printed by wear_dump().
+ */
+#if !defined(MTD_WEAR_DUMP_TOP)
+#define MTD_WEAR_DUMP_TOP                       8
+#endif
+
+/**
+ * @brief   Size of reserved region in bytes for given number of blocks.
+ */
+#define MTD_WEAR_REGION_SIZE(blocks)            (12 + 4 * (blocks))
+
+/**
+ * @brief   Pass as region to keep counters in RAM only.
+ */
+#define MTD_WEAR_NO_REGION                      0xFFFFFFFFU
+
+namespace nvram {
+
+/**
+ * @brief   Header of reserved region. Followed by array of counters.
+ */
+struct mtd_wear_hdr_t {
+  uint32_t      magic;
+  uint32_t      blocks;
+  uint32_t      sum;        /* checksum of counters array */
+};
+static_assert(sizeof(mtd_wear_hdr_t) == MTD_WEAR_REGION_SIZE(0), "Header size mismatch");
+
+/**
+ * @brief   Program count of single block.
+ */
+struct mtd_wear_t {
+  uint32_t      block;
+  uint32_t      count;
+};
+
+uint32_t wear_checksum(const uint8_t *data, size_t len, uint32_t sum);
+size_t wear_hottest(const uint32_t *counters, size_t blocks,
+                    mtd_wear_t *dst, size_t max);
+void wear_print(BaseSequentialStream *chp, const mtd_wear_t *hot, size_t n,
+                uint32_t blocksize);
+
+} /* namespace */
+
+#endif /* MTD_WEAR_HPP_ */
@@ -0,0 +1,591 @@
+/*
+    Abstraction layer for EEPROM ICs.
+
+    Copyright (C) 2012..2016 Uladzimir Pylinski aka barthess
+
+    This file is part of 24AA lib.
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include <string.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#include "ch.hpp"
+#include "hal.h"
+#include "chprintf.h"
+
+#include "nvram_file.hpp"
+#include "nvram_fs.hpp"
+#include "nvram_bench.hpp"
+
+using namespace nvram;
+
+/*
+ ******************************************************************************
+ * DEFINES
+ ******************************************************************************
+ */
+
+#define FILE_BLOCK_SIZE     64
+
+/* most meters single case runs at once */
+#define BENCH_METERS        4
+
+/*
+ ******************************************************************************
+ * EXTERNS
+ ******************************************************************************
+ */
+
+/*
+ ******************************************************************************
+ * PROTOTYPES
+ ******************************************************************************
+ */
+
+/*
+ ******************************************************************************
+ * GLOBAL VARIABLES
+ ******************************************************************************
+ */
+
+/**
+ * @brief   Sample storage of meters, kept off the caller's stack.
+ */
+static uint32_t meter_samples[BENCH_METERS][NVRAM_BENCH_MAX_SAMPLES];
+
+/**
+ * @brief   Collects samples of single benchmark case.
+ */
+class Meter {
+public:
+  Meter(BenchContext *ctx, const char *name, size_t size, size_t slot) :
+    ctx(ctx), name(name), size(size), n(0), total(0), bus(0), t0(0), b0(0),
+    samples(meter_samples[slot]) {;}
+  void start(void) {
+    b0 = ctx->mtd->bus_transactions();
+    t0 = now();
+  }
+  void stop(void) {
+    const uint32_t dt = elapsed();
+    bus += ctx->mtd->bus_transactions() - b0;
+    total += dt;
+    if (n < NVRAM_BENCH_MAX_SAMPLES)
+      samples[n++] = dt;
+  }
+  void report(void);
+private:
+  uint32_t now(void);
+  uint32_t elapsed(void);
+  uint32_t percentile(size_t p);
+  BenchContext *ctx;
+  const char *name;
+  size_t size;
+  size_t n;
+  uint64_t total;
+  uint32_t bus;
+  uint32_t t0;
+  uint32_t b0;
+  uint32_t *samples;
+};
+
+/*
+ ******************************************************************************
+ ******************************************************************************
+ * LOCAL FUNCTIONS
+ ******************************************************************************
+ ******************************************************************************
+ */
+
+/**
+ * @brief   Start mark: uS of user clock or raw MTD_STATS_TIMESTAMP().
+ */
+uint32_t Meter::now(void) {
+  if (nullptr != ctx->clock)
+    return ctx->clock();
+  else
+    return MTD_STATS_TIMESTAMP();
+}
+
+/**
+ * @brief   uS passed since start mark.
+ * @note    System time is never converted as absolute value, 32-bit
+ *          ST2US() overflows on it.
+ */
+uint32_t Meter::elapsed(void) {
+  if (nullptr != ctx->clock)
+    return ctx->clock() - t0;
+  else
+    return MTD_STATS_ELAPSED_US(t0, MTD_STATS_TIMESTAMP());
+}
+
+/**
+ * @brief   Nearest rank percentile. Samples must be sorted.
+ */
+uint32_t Meter::percentile(size_t p) {
+  size_t rank = (p * n + 99) / 100;
+  if (rank > 0)
+    rank--;
+  return samples[rank];
+}
+
+/**
+ * @brief   Prints single CSV line of results.
+ */
+void Meter::report(void) {
+  uint32_t bps;
+  uint32_t bus10;
+
+  if ((0 == n) || (nullptr == ctx->chn))
+    return;
+
+  /* insertion sort, sample sets are small */
+  for (size_t i=1; i<n; i++) {
+    const uint32_t tmp = samples[i];
+    size_t j = i;
+    while ((j > 0) && (samples[j-1] > tmp)) {
+      samples[j] = samples[j-1];
+      j--;
+    }
+    samples[j] = tmp;
+  }
+
+  if (0 == total)
+    total = 1; /* faster than clock resolution */
+  bps = ((uint64_t)size * n * 1000000) / total;
+  bus10 = (bus * 10) / n;
+
+  chprintf(ctx->chn, "bench,%s,%u,%u,%u,%u,%u,%u,%u,%u.%u\r\n",
+           name, (uint32_t)size, (uint32_t)n, bps,
+           percentile(50), percentile(90), percentile(99), samples[n-1],
+           bus10 / 10, bus10 % 10);
+}
+
+/**
+ *
+ */
+static size_t sample_cnt(BenchContext *ctx) {
+  if ((0 == ctx->samples) || (ctx->samples > NVRAM_BENCH_MAX_SAMPLES))
+    return NVRAM_BENCH_MAX_SAMPLES;
+  else
+    return ctx->samples;
+}
+
+/**
+ * @brief   Raw MTD write and read of given size.
+ * @details Every sample goes to next region so EEPROM does not
+ *          rewrite the same page again and again.
+ */
+static bool mtd_case(BenchContext *ctx, size_t size, size_t misalign) {
+  MtdBase *mtd = ctx->mtd;
+  const size_t N = sample_cnt(ctx);
+  const uint32_t ps = mtd->is_fram() ? 1 : mtd->pagesize();
+  const uint32_t step = ((size + misalign + ps - 1) / ps) * ps;
+  const uint32_t span = mtd->capacity() - step;
+  Meter w(ctx, misalign ? "mtd_write_misaligned" : "mtd_write", size, 0);
+  Meter r(ctx, misalign ? "mtd_read_misaligned" : "mtd_read", size, 1);
+  size_t status;
+
+  for (size_t i=0; i<N; i++) {
+    const uint32_t offset = ((i * step) % span) / ps * ps + misalign;
+    w.start();
+    status = mtd->write(ctx->buf, size, offset);
+    w.stop();
+    if (size != status)
+      return OSAL_FAILED;
+    r.start();
+    status = mtd->read(ctx->buf, size, offset);
+    r.stop();
+    if (size != status)
+      return OSAL_FAILED;
+  }
+
+  w.report();
+  r.report();
+  return OSAL_SUCCESS;
+}
+
+/**
+ * @brief   Device internal copy without and with caller's buffer
+ *          against read and write through user buffer of the same size.
+ */
+static bool copy_case(BenchContext *ctx, size_t size) {
+  MtdBase *mtd = ctx->mtd;
+  const size_t N = sample_cnt(ctx);
+  const uint32_t ps = mtd->is_fram() ? 1 : mtd->pagesize();
+  const uint32_t step = ((size + ps - 1) / ps) * ps;
+  const uint32_t span = mtd->capacity() - 2 * step;
+  Meter c(ctx, "mtd_copy", size, 0);
+  Meter b(ctx, "mtd_copy_buf", size, 1);
+  Meter u(ctx, "mtd_copy_user", size, 2);
+  size_t status;
+
+  for (size_t i=0; i<N; i++) {
+    const uint32_t dst = step + ((i * step) % span) / ps * ps;
+    c.start();
+    status = mtd->copy(0, dst, size);
+    c.stop();
+    if (size != status)
+      return OSAL_FAILED;
+    b.start();
+    status = mtd->copy(0, dst, size, ctx->buf, size);
+    b.stop();
+    if (size != status)
+      return OSAL_FAILED;
+    u.start();
+    status = mtd->read(ctx->buf, size, 0);
+    if (size == status)
+      status = mtd->write(ctx->buf, size, dst);
+    u.stop();
+    if (size != status)
+      return OSAL_FAILED;
+  }
+
+  c.report();
+  b.report();
+  u.report();
+  return OSAL_SUCCESS;
+}
+
+/**
+ *
+ */
+static bool mtd_bench(BenchContext *ctx) {
+  MtdBase *mtd = ctx->mtd;
+  size_t sizes[4] = {1, 16, 0, 0};
+
+  if (mtd->is_fram()) {
+    sizes[2] = 128;
+    sizes[3] = 1024;
+  }
+  else {
+    sizes[2] = mtd->pagesize();
+    sizes[3] = 4 * mtd->pagesize();
+  }
+
+  memset(ctx->buf, 0x5A, ctx->len);
+  for (size_t i=0; i<4; i++) {
+    if ((sizes[i] > ctx->len) || (2 * sizes[i] > mtd->capacity()))
+      continue;
+    if ((OSAL_SUCCESS != mtd_case(ctx, sizes[i], 0)) ||
+        (OSAL_SUCCESS != mtd_case(ctx, sizes[i], 1)))
+      return OSAL_FAILED;
+  }
+
+  if ((sizes[3] <= ctx->len) && (3 * sizes[3] <= mtd->capacity()))
+    return copy_case(ctx, sizes[3]);
+
+  return OSAL_SUCCESS;
+}
+
+/**
+ * @brief   Cost of metadata operations.
+ */
+static bool fs_bench(BenchContext *ctx, Fs &fs) {
+  const size_t N = sample_cnt(ctx);
+  Meter mkfs(ctx, "fs_mkfs", 0, 0);
+  Meter mount(ctx, "fs_mount", 0, 1);
+  Meter create(ctx, "fs_create", 0, 2);
+  Meter open(ctx, "fs_open", 0, 3);
+  File *file;
+  bool status;
+
+  for (size_t i=0; i<N; i++) {
+    mkfs.start();
+    status = fs.mkfs();
+    mkfs.stop();
+    if (OSAL_SUCCESS != status)
+      return OSAL_FAILED;
+
+    mount.start();
+    status = fs.mount();
+    mount.stop();
+    if (OSAL_SUCCESS != status)
+      return OSAL_FAILED;
+
+    create.start();
+    file = fs.create("bench", FILE_BLOCK_SIZE);
+    create.stop();
+    if (nullptr == file)
+      return OSAL_FAILED;
+    fs.close(file);
+
+    open.start();
+    file = fs.open("bench");
+    open.stop();
+    if (nullptr == file)
+      return OSAL_FAILED;
+    fs.close(file);
+
+    if (OSAL_SUCCESS != fs.umount())
+      return OSAL_FAILED;
+  }
+
+  mkfs.report();
+  mount.report();
+  create.report();
+  open.report();
+  return OSAL_SUCCESS;
+}
+
+/**
+ * @brief   Metadata and data cost of every on-device format.
+ * @details Shows what 32-bit extents and padded superblock cost on
+ *          small parts against legacy V0 layout.
+ */
+static bool fs_format_bench(BenchContext *ctx, Fs &fs) {
+  static const char *names[][3] = {
+      {"fs_mkfs_v0", "fs_create_v0", "fs_write_v0"},
+      {"fs_mkfs_v1", "fs_create_v1", "fs_write_v1"},
+      {"fs_mkfs_v2", "fs_create_v2", "fs_write_v2"},
+  };
+  const size_t N = sample_cnt(ctx);
+  File *file;
+  size_t written;
+  bool status;
+
+  if (FILE_BLOCK_SIZE > ctx->len)
+    return OSAL_SUCCESS;
+  memset(ctx->buf, 0xA5, FILE_BLOCK_SIZE);
+
+  for (size_t f=FS_FORMAT_V0; f<=FS_FORMAT_V2; f++) {
+    Meter mkfs(ctx, names[f][0], 0, 0);
+    Meter create(ctx, names[f][1], 0, 1);
+    Meter write(ctx, names[f][2], FILE_BLOCK_SIZE, 2);
+
+    for (size_t i=0; i<N; i++) {
+      mkfs.start();
+      status = fs.mkfs(static_cast<fs_format_t>(f));
+      mkfs.stop();
+      if ((OSAL_SUCCESS != status) || (OSAL_SUCCESS != fs.mount()))
+        return OSAL_FAILED;
+
+      create.start();
+      file = fs.create("bench", FILE_BLOCK_SIZE);
+      create.stop();
+      if (nullptr == file) {
+        fs.umount();
+        return OSAL_FAILED;
+      }
+
+      write.start();
+      written = file->write(ctx->buf, FILE_BLOCK_SIZE);
+      write.stop();
+
+      fs.close(file);
+      if ((FILE_BLOCK_SIZE != written) || (OSAL_SUCCESS != fs.umount()))
+        return OSAL_FAILED;
+    }
+
+    mkfs.report();
+    create.report();
+    write.report();
+  }
+
+  return OSAL_SUCCESS;
+}
+
+/**
+ * @brief   Rewrite of two files verified by read back against the same
+ *          update made atomic by journal.
+ */
+static bool txn_bench(BenchContext *ctx, Fs &fs) {
+  const size_t N = sample_cnt(ctx);
+  const size_t ps = ctx->mtd->is_fram() ? 16 : ctx->mtd->pagesize();
+  uint8_t *ref = ctx->buf;
+  uint8_t *chk = ctx->buf + FILE_BLOCK_SIZE;
+  Meter plain(ctx, "txn_plain", 2 * FILE_BLOCK_SIZE, 0);
+  Meter journal(ctx, "txn_journal", 2 * FILE_BLOCK_SIZE, 1);
+  File *f[2] = {nullptr, nullptr};
+  size_t status;
+  bool ok;
+
+  if (2 * FILE_BLOCK_SIZE > ctx->len)
+    return OSAL_SUCCESS;
+
+  if ((OSAL_SUCCESS != fs.mkfs()) || (OSAL_SUCCESS != fs.mount()))
+    return OSAL_FAILED;
+  if (OSAL_SUCCESS != fs.mkjournal(4 * FILE_BLOCK_SIZE + ps))
+    goto FAILED;
+  f[0] = fs.create("txn0", FILE_BLOCK_SIZE);
+  f[1] = fs.create("txn1", FILE_BLOCK_SIZE);
+  if ((nullptr == f[0]) || (nullptr == f[1]))
+    goto FAILED;
+
+  for (size_t i=0; i<N; i++) {
+    memset(ref, i, FILE_BLOCK_SIZE);
+
+    plain.start();
+    ok = true;
+    for (size_t k=0; k<2; k++) {
+      f[k]->setPosition(0);
+      status = f[k]->write(ref, FILE_BLOCK_SIZE);
+      f[k]->setPosition(0);
+      if (FILE_BLOCK_SIZE == status)
+        status = f[k]->read(chk, FILE_BLOCK_SIZE);
+      ok = ok && (FILE_BLOCK_SIZE == status) &&
+                 (0 == memcmp(ref, chk, FILE_BLOCK_SIZE));
+    }
+    plain.stop();
+    if (!ok)
+      goto FAILED;
+
+    journal.start();
+    ok = (OSAL_SUCCESS == fs.begin());
+    for (size_t k=0; ok && (k<2); k++) {
+      f[k]->setPosition(0);
+      ok = (FILE_BLOCK_SIZE == f[k]->write(ref, FILE_BLOCK_SIZE));
+    }
+    if (ok)
+      ok = (OSAL_SUCCESS == fs.commit());
+    else
+      fs.abort();
+    journal.stop();
+    if (!ok)
+      goto FAILED;
+  }
+
+  fs.close(f[0]);
+  fs.close(f[1]);
+  if (OSAL_SUCCESS != fs.umount())
+    return OSAL_FAILED;
+
+  plain.report();
+  journal.report();
+  return OSAL_SUCCESS;
+
+FAILED:
+  for (size_t k=0; k<2; k++) {
+    if (nullptr != f[k])
+      fs.close(f[k]);
+  }
+  fs.umount();
+  return OSAL_FAILED;
+}
+
+/**
+ * @brief   Sequential file access by blocks and by bytes.
+ */
+static bool file_bench(BenchContext *ctx, Fs &fs) {
+  const size_t N = sample_cnt(ctx);
+  const size_t size = N * FILE_BLOCK_SIZE;
+  Meter write(ctx, "file_write", FILE_BLOCK_SIZE, 0);
+  Meter read(ctx, "file_read", FILE_BLOCK_SIZE, 1);
+  Meter put(ctx, "file_put", 1, 2);
+  Meter get(ctx, "file_get", 1, 3);
+  File *file = nullptr;
+  size_t status;
+  msg_t c;
+
+  if ((FILE_BLOCK_SIZE > ctx->len) || (2 * size > ctx->mtd->capacity()))
+    return OSAL_SUCCESS;
+
+  if ((OSAL_SUCCESS != fs.mkfs()) || (OSAL_SUCCESS != fs.mount()))
+    return OSAL_FAILED;
+  file = fs.create("bench", size);
+  if (nullptr == file)
+    goto FAILED;
+
+  memset(ctx->buf, 0xA5, FILE_BLOCK_SIZE);
+  for (size_t i=0; i<N; i++) {
+    write.start();
+    status = file->write(ctx->buf, FILE_BLOCK_SIZE);
+    write.stop();
+    if (FILE_BLOCK_SIZE != status)
+      goto FAILED;
+  }
+  if (FILE_OK != file->setPosition(0))
+    goto FAILED;
+  for (size_t i=0; i<N; i++) {
+    read.start();
+    status = file->read(ctx->buf, FILE_BLOCK_SIZE);
+    read.stop();
+    if (FILE_BLOCK_SIZE != status)
+      goto FAILED;
+  }
+
+  /* single bytes mostly hit file cache, flushes show up in percentiles */
+  if (FILE_OK != file->setPosition(0))
+    goto FAILED;
+  for (size_t i=0; i<N; i++) {
+    put.start();
+    c = file->put(i);
+    put.stop();
+    if (MSG_OK != c)
+      goto FAILED;
+  }
+  if ((OSAL_SUCCESS != file->flush()) || (FILE_OK != file->setPosition(0)))
+    goto FAILED;
+  for (size_t i=0; i<N; i++) {
+    get.start();
+    c = file->get();
+    get.stop();
+    if ((msg_t)(i & 0xFF) != c)
+      goto FAILED;
+  }
+
+  fs.close(file);
+  if (OSAL_SUCCESS != fs.umount())
+    return OSAL_FAILED;
+
+  write.report();
+  read.report();
+  put.report();
+  get.report();
+  return OSAL_SUCCESS;
+
+FAILED:
+  if (nullptr != file)
+    fs.close(file);
+  fs.umount();
+  return OSAL_FAILED;
+}
+
+/*
+ ******************************************************************************
+ * EXPORTED FUNCTIONS
+ ******************************************************************************
+ */
+
+/**
+ * @brief   Runs all benchmarks printing results as CSV lines.
+ * @note    Destroys data on device.
+ * @note    Not reentrant, samples live in static storage. File system
+ *          object is placed on caller's stack, so calling thread needs
+ *          sizeof(Fs) plus about 512 bytes of stack.
+ *
+ * @return  OSAL_FAILED if any measured operation failed.
+ */
+bool nvram::Benchmark(BenchContext *ctx) {
+
+  osalDbgCheck((nullptr != ctx->mtd) && (nullptr != ctx->buf)
+            && (0 != ctx->len));
+
+  Fs fs(*ctx->mtd);
+
+  if (nullptr != ctx->chn)
+    chprintf(ctx->chn, "# bench,case,size,ops,bytes_per_s,"
+                       "p50_us,p90_us,p99_us,max_us,bus_per_op\r\n");
+
+  if (OSAL_SUCCESS != mtd_bench(ctx))
+    return OSAL_FAILED;
+  if (OSAL_SUCCESS != fs_bench(ctx, fs))
+    return OSAL_FAILED;
+  if (OSAL_SUCCESS != fs_format_bench(ctx, fs))
+    return OSAL_FAILED;
+  if (OSAL_SUCCESS != txn_bench(ctx, fs))
+    return OSAL_FAILED;
+  return file_bench(ctx, fs);
+}
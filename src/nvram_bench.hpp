@@ -0,0 +1,57 @@
+/*
+    Abstraction layer for EEPROM ICs.
+
+    Copyright (C) 2012..2016 Uladzimir Pylinski aka barthess
+
+    This file is part of 24AA lib.
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#ifndef NVRAM_BENCH_HPP_
+#define NVRAM_BENCH_HPP_
+
+#include "mtd_base.hpp"
+
+/**
+ * @brief   Maximum number of samples per benchmark case.
+ * @note    Every sample costs 4 bytes of RAM.
+ */
+#if !defined(NVRAM_BENCH_MAX_SAMPLES)
+#define NVRAM_BENCH_MAX_SAMPLES           64
+#endif
+
+namespace nvram {
+
+/**
+ * @brief   Time source returning microseconds.
+ */
+typedef uint32_t (*benchclock_t)(void);
+
+/**
+ *
+ */
+struct BenchContext {
+  nvram::MtdBase        *mtd;
+  uint8_t               *buf;
+  size_t                len;        // length of buffer
+  size_t                samples;    // samples per case. Set to 0 for maximum
+  benchclock_t          clock;      // set to nullptr to use system time
+  BaseSequentialStream  *chn;       // results output
+};
+
+bool Benchmark(BenchContext *ctx);
+
+} // namespace
+
+#endif /* NVRAM_BENCH_HPP_ */
@@ -22,6 +22,7 @@
 #include "hal.h"
 
 #include "nvram_file.hpp"
+#include "nvram_journal.hpp"
 
 using namespace chibios_fs;
 namespace nvram {
@@ -57,23 +58,6 @@ namespace nvram {
  ******************************************************************************
  ******************************************************************************
  */
-/**
- *
- */
-msg_t File::put(uint8_t b){
-  (void)b;
-  osalSysHalt("Unrealized");
-  return 0;
-}
-
-/**
- *
- */
-msg_t File::get(void){
-  osalSysHalt("Unrealized");
-  return 0;
-}
-
 /**
  *
  */
@@ -91,7 +75,8 @@ uint32_t File::getAndClearLastError(void){
  *
  */
 File::File(void) :
-mtd(nullptr), start(0), size(0), tip(0)
+mtd(nullptr), journal(nullptr), start(0), size(0), tip(0),
+cache_pos(0), cache_len(0), cache_dirty(false)
 {
   return;
 }
@@ -101,9 +86,12 @@ mtd(nullptr), start(0), size(0), tip(0)
  */
 void File::__test_ctor(MtdBase *mtd, fileoffset_t start, fileoffset_t size){
   this->mtd = mtd;
+  this->journal = nullptr;
   this->tip = 0;
   this->start = start;
   this->size = size;
+  this->cache_len = 0;
+  this->cache_dirty = false;
 }
 
 /**
@@ -122,7 +110,12 @@ size_t File::clamp_size(size_t n){
  *
  */
 void File::close(void){
+  if (nullptr != this->mtd)
+    flush();
+  this->cache_len = 0;
+  this->cache_dirty = false;
   this->mtd = nullptr;
+  this->journal = nullptr;
   this->tip = 0;
   this->start = 0;
   this->size = 0;
@@ -172,6 +165,9 @@ size_t File::read(uint8_t *buf, size_t n) {
   if (0 == n)
     return 0;
 
+  if (OSAL_SUCCESS != flush())
+    return 0;
+
   acquired = mtd->read(buf, n, tip + start);
   tip += acquired;
   return acquired;
@@ -191,9 +187,158 @@ size_t File::write(const uint8_t *buf, size_t n) {
   if (0 == n)
     return 0;
 
-  written = mtd->write(buf, n, tip + start);
+  if (OSAL_SUCCESS != flush())
+    return 0;
+  this->cache_len = 0; /* read ahead data may become stale */
+
+  written = device_write(buf, n, tip + start);
   tip += written;
   return written;
 }
 
+/**
+ * @brief   Gathered write of several buffers at current position.
+ * @details Buffers go to device by single MtdBase::writev(), so they
+ *          share page sized transactions.
+ * @return  Number of written bytes, 0 if data does not fit in file.
+ */
+size_t File::writev(const iovec_t *iov, size_t iovcnt) {
+
+  size_t n = 0;
+  size_t written = 0;
+
+  osalDbgAssert(nullptr != this->mtd, "File not opened");
+  osalDbgCheck(nullptr != iov);
+
+  for (size_t i=0; i<iovcnt; i++)
+    n += iov[i].len;
+  if ((0 == n) || (clamp_size(n) != n))
+    return 0;
+
+  if (OSAL_SUCCESS != flush())
+    return 0;
+  this->cache_len = 0; /* read ahead data may become stale */
+
+  if ((nullptr != journal) && journal->is_active()) {
+    for (size_t i=0; i<iovcnt; i++) {
+      const size_t got = journal->append(static_cast<uint8_t *>(iov[i].base),
+                                         iov[i].len, tip + start + written);
+      written += got;
+      if (got != iov[i].len)
+        break;
+    }
+  }
+  else {
+    written = mtd->writev(iov, iovcnt, tip + start);
+  }
+
+  tip += written;
+  return written;
+}
+
+/**
+ * @brief   Write data to device or to journal if transaction is active.
+ */
+size_t File::device_write(const uint8_t *buf, size_t n, uint32_t offset) {
+
+  if ((nullptr != journal) && journal->is_active())
+    return journal->append(buf, n, offset);
+  else
+    return mtd->write(buf, n, offset);
+}
+
+/**
+ * @brief   Write bytes gathered by put() to device.
+ */
+bool File::flush(void) {
+  size_t written;
+
+  osalDbgAssert(nullptr != this->mtd, "File not opened");
+
+  if (!cache_dirty)
+    return OSAL_SUCCESS;
+
+  cache_dirty = false;
+  if ((nullptr != journal) && journal->is_active()) {
+    written = journal->append(cache, cache_len, start + cache_pos);
+    /* device still holds old data, so buffer does not reflect it */
+    if (cache_len == written) {
+      cache_len = 0;
+      return OSAL_SUCCESS;
+    }
+  }
+  else {
+    written = mtd->write(cache, cache_len, start + cache_pos);
+    /* buffer still holds valid copy of device data */
+    if (cache_len == written)
+      return OSAL_SUCCESS;
+  }
+
+  cache_len = 0;
+  return OSAL_FAILED;
+}
+
+/**
+ * @brief   Buffered single byte write.
+ * @details Bytes are gathered in RAM and written when buffer is full or
+ *          when page boundary reached, so no write spans two pages.
+ *          Call flush() to force write.
+ */
+msg_t File::put(uint8_t b){
+
+  osalDbgAssert(nullptr != this->mtd, "File not opened");
+
+  if (tip >= size)
+    return MSG_RESET;
+
+  /* start new chunk if buffer does not continue current position */
+  if (!cache_dirty || (tip != cache_pos + cache_len)) {
+    if (OSAL_SUCCESS != flush())
+      return MSG_RESET;
+    cache_pos = tip;
+    cache_len = 0;
+    cache_dirty = true;
+  }
+
+  cache[cache_len++] = b;
+  tip++;
+
+  if ((NVRAM_FILE_CACHE_SIZE == cache_len) ||
+      ((mtd->pagecount() > 1) && (0 == (start + tip) % mtd->pagesize()))) {
+    if (OSAL_SUCCESS != flush())
+      return MSG_RESET;
+  }
+
+  return MSG_OK;
+}
+
+/**
+ * @brief   Buffered single byte read.
+ * @return  Byte value or MSG_RESET on end of file or error.
+ */
+msg_t File::get(void){
+  size_t n;
+
+  osalDbgAssert(nullptr != this->mtd, "File not opened");
+
+  if (tip >= size)
+    return MSG_RESET;
+
+  if (cache_dirty || (tip < cache_pos) || (tip >= cache_pos + cache_len)) {
+    if (OSAL_SUCCESS != flush())
+      return MSG_RESET;
+    n = size - tip;
+    if (n > NVRAM_FILE_CACHE_SIZE)
+      n = NVRAM_FILE_CACHE_SIZE;
+    cache_pos = tip;
+    cache_len = mtd->read(cache, n, start + tip);
+    if (cache_len != n) {
+      cache_len = 0;
+      return MSG_RESET;
+    }
+  }
+
+  return cache[tip++ - cache_pos];
+}
+
 } /* namespace */
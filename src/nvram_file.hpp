@@ -21,16 +21,52 @@
 #ifndef NVRAM_FILE_HPP_
 #define NVRAM_FILE_HPP_
 
+#include <cstring>
+#include <type_traits>
+
 #include "fs.hpp"
 #include "mtd_base.hpp"
 
+#include "nvram_fs_conf.h"
+
+/**
+ * @brief   Size of per file buffer used by put() and get().
+ * @note    Sequential put() programs every EEPROM page
+ *          pagesize / NVRAM_FILE_CACHE_SIZE times, rounded up. Only
+ *          buffer not smaller than page gives one program cycle per page.
+ */
+#if !defined(NVRAM_FILE_CACHE_SIZE)
+#define NVRAM_FILE_CACHE_SIZE                   16
+#endif
+
+#if NVRAM_FILE_CACHE_SIZE < 1
+#error "NVRAM_FILE_CACHE_SIZE must be at least 1"
+#endif
+
+/**
+ * @brief   Arrays are stored in little endian byte order. Big endian
+ *          targets convert data through stack buffer of this size.
+ */
+#if !defined(NVRAM_FILE_SWAP_BUF_SIZE)
+#define NVRAM_FILE_SWAP_BUF_SIZE                32
+#endif
+
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+#define NVRAM_FILE_NEED_SWAP                    TRUE
+#else
+#define NVRAM_FILE_NEED_SWAP                    FALSE
+#endif
+
 namespace nvram {
 
+class Journal; /* forward declaration */
+
 /**
  *
  */
 class File : public chibios_fs::BaseFileStreamInterface {
   friend class Fs;
+  friend class Journal;
 public:
   File(void);
   void __test_ctor(MtdBase *mtd, uint32_t start, uint32_t size);
@@ -40,19 +76,134 @@ public:
   uint32_t setPosition(uint32_t pos);
 
   size_t write(const uint8_t *buf, size_t n);
+  size_t writev(const iovec_t *iov, size_t iovcnt);
   size_t read(uint8_t *buf, size_t n);
   msg_t put(uint8_t b);
   msg_t get(void);
+  bool flush(void);
+
+  template <typename T> size_t read_array(T *dst, size_t n);
+  template <typename T> size_t write_array(const T *src, size_t n);
+  template <typename T> bool read_record(T *rec);
+  template <typename T> bool write_record(const T &rec);
 
 private:
+  template <typename T> static void swap_array(T *buf, size_t n);
   size_t clamp_size(size_t n);
+  size_t device_write(const uint8_t *buf, size_t n, uint32_t offset);
   void close(void);
   MtdBase *mtd;
-  uint16_t start; /* file start in bytes relative to device start */
-  uint16_t size;  /* size (bytes) */
-  uint16_t tip;   /* current position in file (bytes) */
+  Journal *journal; /* set when writes may be journaled */
+  uint32_t start; /* file start in bytes relative to device start */
+  uint32_t size;  /* size (bytes) */
+  uint32_t tip;   /* current position in file (bytes) */
+  /* Buffer for put() and get(). It holds either read ahead data
+   * or bytes gathered by put() and not written yet (dirty). */
+  uint8_t cache[NVRAM_FILE_CACHE_SIZE];
+  uint32_t cache_pos; /* file position of the first buffered byte */
+  uint32_t cache_len; /* number of valid bytes in buffer */
+  bool cache_dirty;
 };
 
+/**
+ * @brief   Reverse byte order of every array element.
+ */
+template <typename T>
+void File::swap_array(T *buf, size_t n) {
+  uint8_t *b = reinterpret_cast<uint8_t *>(buf);
+
+  for (size_t i=0; i<n; i++) {
+    for (size_t k=0; k<sizeof(T)/2; k++) {
+      uint8_t tmp = b[k];
+      b[k] = b[sizeof(T) - 1 - k];
+      b[sizeof(T) - 1 - k] = tmp;
+    }
+    b += sizeof(T);
+  }
+}
+
+/**
+ * @brief   Read array of scalars stored in little endian byte order.
+ * @details Whole array is acquired by single device read on little
+ *          endian targets.
+ *
+ * @return  Number of completely read elements.
+ */
+template <typename T>
+size_t File::read_array(T *dst, size_t n) {
+  static_assert(std::is_arithmetic<T>::value, "Only scalar types allowed");
+  size_t acquired;
+
+  acquired = read(reinterpret_cast<uint8_t *>(dst), n * sizeof(T)) / sizeof(T);
+#if NVRAM_FILE_NEED_SWAP
+  swap_array(dst, acquired);
+#endif
+  return acquired;
+}
+
+/**
+ * @brief   Write array of scalars in little endian byte order.
+ * @details Array is passed to MTD by single call (chunks of
+ *          NVRAM_FILE_SWAP_BUF_SIZE on big endian targets), so it will be
+ *          written by page sized transactions.
+ *
+ * @return  Number of completely written elements.
+ */
+template <typename T>
+size_t File::write_array(const T *src, size_t n) {
+  static_assert(std::is_arithmetic<T>::value, "Only scalar types allowed");
+
+#if NVRAM_FILE_NEED_SWAP
+  const size_t chunk = (NVRAM_FILE_SWAP_BUF_SIZE >= sizeof(T)) ?
+                       (NVRAM_FILE_SWAP_BUF_SIZE / sizeof(T)) : 1;
+  T tmp[chunk];
+  size_t written = 0;
+
+  while (written < n) {
+    size_t len = ((n - written) > chunk) ? chunk : (n - written);
+    size_t status;
+    memcpy(tmp, &src[written], len * sizeof(T));
+    swap_array(tmp, len);
+    status = write(reinterpret_cast<const uint8_t *>(tmp), len * sizeof(T));
+    written += status / sizeof(T);
+    if (status != len * sizeof(T))
+      break;
+  }
+  return written;
+#else
+  return write(reinterpret_cast<const uint8_t *>(src), n * sizeof(T)) / sizeof(T);
+#endif
+}
+
+/**
+ * @brief   Read structure as single transaction.
+ * @note    Structure is stored in native layout and byte order. Use packed
+ *          structures of fixed width fields to keep format portable.
+ */
+template <typename T>
+bool File::read_record(T *rec) {
+  static_assert(std::is_pod<T>::value, "Only POD types allowed");
+
+  if (sizeof(T) == read(reinterpret_cast<uint8_t *>(rec), sizeof(T)))
+    return OSAL_SUCCESS;
+  else
+    return OSAL_FAILED;
+}
+
+/**
+ * @brief   Write structure as single transaction.
+ * @note    See read_record().
+ */
+template <typename T>
+bool File::write_record(const T &rec) {
+  static_assert(std::is_pod<T>::value, "Only POD types allowed");
+
+  if (sizeof(T) == write(reinterpret_cast<const uint8_t *>(&rec), sizeof(T)))
+    return OSAL_SUCCESS;
+  else
+    return OSAL_FAILED;
+}
+
 } /* namespace */
 
 #endif /* NVRAM_FILE_HPP_ */
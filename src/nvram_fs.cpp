@@ -51,25 +51,34 @@ namespace nvram {
  ******************************************************************************
  */
 
+/**
+ * @brief   Magic numbers. Index is superblock format.
+ */
+static const uint8_t magic[][4] = {
+    {'2','4','a','a'},
+    {'2','4','a','b'},
+    {'2','4','a','c'},
+};
+
 /**
  *
  */
-static const uint8_t magic[] = {'2','4','a','a'};
+static const size_t MAGIC_LEN = sizeof(magic[0]);
 
 /**
  *
  */
-static const fileoffset_t FAT_OFFSET = sizeof(magic) + sizeof(filecount_t);
+static const size_t FORMAT_CNT = sizeof(magic) / MAGIC_LEN;
 
 /**
  *
  */
-static const size_t SUPERBLOCK_SIZE =
-    FAT_OFFSET
-    + sizeof(toc_item_t) * NVRAM_FS_MAX_FILE_CNT
-    + sizeof(checksum_t);
+static const fileoffset_t FAT_OFFSET = MAGIC_LEN + sizeof(filecount_t);
 
-static uint8_t dbg_super[SUPERBLOCK_SIZE];
+/**
+ * @brief   TOC items fetched by single batched read.
+ */
+static const size_t TOC_BATCH = 4;
 
 /*
   Name  : CRC-8
@@ -127,12 +136,147 @@ static const uint8_t Crc8Table[256] = {
  *                  is generally 0xFF.  For subsequent blocks it is result
  *                  of calculation of previous block(s).
  */
-static uint8_t nvramcrc(const uint8_t *buf, size_t len, uint8_t crc) {
+uint8_t nvramcrc(const uint8_t *buf, size_t len, uint8_t crc) {
   while (len--)
     crc = Crc8Table[crc ^ *buf++];
   return crc;
 }
 
+/**
+ * @brief   Stores integer in little endian byte order.
+ */
+void pack_le(uint8_t *buf, uint32_t v, size_t len) {
+  for (size_t i=0; i<len; i++) {
+    buf[i] = v & 0xFF;
+    v >>= 8;
+  }
+}
+
+/**
+ * @brief   Loads integer stored in little endian byte order.
+ */
+uint32_t unpack_le(const uint8_t *buf, size_t len) {
+  uint32_t ret = 0;
+  for (size_t i=len; i>0; i--) {
+    ret <<= 8;
+    ret |= buf[i-1];
+  }
+  return ret;
+}
+
+/**
+ * @brief   Calculates superblock geometry for requested format.
+ */
+void Fs::select_format(fs_format_t format) {
+
+  osalDbgCheck(format < FORMAT_CNT);
+
+  this->format = format;
+  if (FS_FORMAT_V0 == format)
+    extent_len = sizeof(uint16_t);
+  else
+    extent_len = sizeof(uint32_t);
+
+  toc_item_len = NVRAM_FS_MAX_FILE_NAME_LEN + 2 * extent_len;
+
+  if (FS_FORMAT_V2 == format) {
+    /* header (magic, count, checksum) and every TOC item occupy
+     * their own pages, so any metadata update is single page program */
+    const uint32_t hdr_len = FAT_OFFSET + sizeof(checksum_t);
+    uint32_t ps = mtd.pagesize();
+    if (1 == mtd.pagecount())
+      ps = 1; /* FRAM does not need any padding */
+    csum_offset = FAT_OFFSET;
+    toc_offset  = ((hdr_len + ps - 1) / ps) * ps;
+    toc_stride  = ((toc_item_len + ps - 1) / ps) * ps;
+    sb_size     = toc_offset + toc_stride * NVRAM_FS_MAX_FILE_CNT;
+  }
+  else {
+    /* packed layout with checksum at the end */
+    toc_offset  = FAT_OFFSET;
+    toc_stride  = toc_item_len;
+    csum_offset = toc_offset + toc_stride * NVRAM_FS_MAX_FILE_CNT;
+    sb_size     = csum_offset + sizeof(checksum_t);
+  }
+
+  osalDbgCheck(toc_item_len <= sizeof(toc_buf));
+}
+
+/**
+ * @brief   Serializes TOC item to its on-device representation.
+ * @note    Legacy format stores raw packed structure of little endian MCU,
+ *          so byte order is fixed to little endian for all formats.
+ */
+void Fs::toc_encode(const toc_item_t *ti, uint8_t *buf) {
+  memcpy(buf, ti->name, NVRAM_FS_MAX_FILE_NAME_LEN);
+  buf += NVRAM_FS_MAX_FILE_NAME_LEN;
+  pack_le(buf, ti->start, extent_len);
+  buf += extent_len;
+  pack_le(buf, ti->size, extent_len);
+}
+
+/**
+ *
+ */
+void Fs::toc_decode(toc_item_t *ti, const uint8_t *buf) {
+  memcpy(ti->name, buf, NVRAM_FS_MAX_FILE_NAME_LEN);
+  buf += NVRAM_FS_MAX_FILE_NAME_LEN;
+  ti->start = unpack_le(buf, extent_len);
+  buf += extent_len;
+  ti->size = unpack_le(buf, extent_len);
+}
+
+/**
+ * @brief   Return end of space addressable by current format.
+ * @details Bound is exclusive: 16-bit extents still reach the last byte
+ *          of 64 KiB part, file starting at 0xFFFF may be 1 byte long.
+ */
+uint32_t Fs::space_limit(void) {
+  const uint32_t cap = mtd.capacity();
+
+  if (extent_len >= sizeof(uint32_t))
+    return cap;
+  else {
+    const uint32_t lim = 1UL << (8 * extent_len);
+    return (cap < lim) ? cap : lim;
+  }
+}
+
+/**
+ * @brief   Return offset of the first byte not occupied by any file.
+ */
+uint32_t Fs::first_free_byte(void) {
+  toc_item_t ti;
+  size_t file_cnt;
+
+  file_cnt = get_file_cnt();
+  if (file_cnt > 0) {
+    read_toc_item(&ti, file_cnt - 1);
+    return ti.start + ti.size;
+  }
+  else {
+    return super.start + super.size;
+  }
+}
+
+/**
+ * @brief   Round address up to requested alignment.
+ *
+ * @param[in] align   alignment in bytes or @p ALIGN_PAGE. For FRAM the
+ *                    page alignment makes no sense and is ignored.
+ */
+uint32_t Fs::align_up(uint32_t addr, uint32_t align) {
+
+  if (ALIGN_PAGE == align) {
+    if (mtd.pagecount() > 1)
+      align = mtd.pagesize();
+    else
+      align = 1;
+  }
+
+  return ((addr + align - 1) / align) * align;
+}
+
 /**
  *
  */
@@ -140,7 +284,7 @@ void Fs::open_super(void) {
   super.mtd = &mtd;
   super.tip = 0;
   super.start = 0;
-  super.size = SUPERBLOCK_SIZE;
+  super.size = sb_size;
 }
 
 /**
@@ -178,35 +322,31 @@ bool Fs::is_mounted(void) {
 /**
  *
  */
-bool Fs::mkfs(void) {
-  checksum_t sum = 0xFF; /* initial CRC vector */
-  size_t written;
+bool Fs::mkfs(fs_format_t format) {
+  size_t status;
 
   osalDbgCheck((this->files_opened == 0) && (nullptr == super.mtd));
+  select_format(format);
   open_super();
   osalDbgAssert((super.start + super.size) < mtd.capacity(), "Overflow");
 
-  /* write magic and zero file count */
-  memcpy(toc_buf, magic, sizeof(magic));
-  toc_buf[sizeof(magic)] = 0; /* existing files count */
+  /* write magic */
   if (FILE_OK != super.setPosition(0))
     goto FAILED;
-  if (FAT_OFFSET != super.write(toc_buf, FAT_OFFSET))
+  if (MAGIC_LEN != super.write(magic[format], MAGIC_LEN))
     goto FAILED;
-  sum = nvramcrc(toc_buf, FAT_OFFSET, sum);
 
   /* write empty FAT */
   memset(toc_buf, 0, sizeof(toc_buf));
   for (size_t i=0; i<NVRAM_FS_MAX_FILE_CNT; i++){
-    written = super.write(toc_buf, sizeof(toc_buf));
-    if (sizeof(toc_buf) != written)
+    status = super.setPosition(toc_offset + i * toc_stride);
+    osalDbgCheck(FILE_OK == status);
+    if (toc_item_len != super.write(toc_buf, toc_item_len))
       goto FAILED;
-    sum = nvramcrc(toc_buf, sizeof(toc_buf), sum);
   }
 
-  /* seal superblock */
-  memcpy(toc_buf, &sum, sizeof(checksum_t));
-  if (sizeof(checksum_t) != super.write(toc_buf, sizeof(checksum_t)))
+  /* zero file count and seal superblock */
+  if (OSAL_SUCCESS != seal(0))
     goto FAILED;
 
   super.close();
@@ -226,49 +366,83 @@ void Fs::get_magic(uint8_t *result){
   status = super.setPosition(0);
   osalDbgCheck(FILE_OK == status);
 
-  status = super.read(result, sizeof(magic));
-  osalDbgCheck(sizeof(magic) == status);
+  status = super.read(result, MAGIC_LEN);
+  osalDbgCheck(MAGIC_LEN == status);
 }
 
 /**
+ * @brief   Calculate superblock checksum for given files count.
+ * @details Checksum covers magic, files count and all TOC items.
+ *          Padding between TOC slots is not covered.
  *
+ * @return  OSAL_FAILED if TOC can not be read.
  */
-checksum_t Fs::get_checksum(void){
-  checksum_t ret;
-  size_t status;
-
-  status = super.setPosition(SUPERBLOCK_SIZE - sizeof(checksum_t));
-  osalDbgCheck(FILE_OK == status);
-
-  status = super.read(&ret, sizeof(checksum_t));
-  osalDbgCheck(sizeof(checksum_t)== status);
+bool Fs::calc_checksum(filecount_t cnt, checksum_t *result){
+  checksum_t sum = 0xFF; /* initial CRC vector */
+  uint8_t magic_buf[MAGIC_LEN];
+  uint8_t items[TOC_BATCH][sizeof(toc_item_t)];
+  read_range_t r[TOC_BATCH];
+  size_t n, total, status;
+
+  get_magic(magic_buf);
+  sum = nvramcrc(magic_buf, MAGIC_LEN, sum);
+  sum = nvramcrc(&cnt, sizeof(cnt), sum);
+
+  /* read TOC items by batches to save bus transactions */
+  for (size_t i=0; i<NVRAM_FS_MAX_FILE_CNT; i+=n){
+    n = NVRAM_FS_MAX_FILE_CNT - i;
+    if (n > TOC_BATCH)
+      n = TOC_BATCH;
+    total = 0;
+    for (size_t k=0; k<n; k++) {
+      r[k].buf = items[k];
+      r[k].len = toc_item_len;
+      r[k].offset = super.start + toc_offset + (i + k) * toc_stride;
+      total += toc_item_len;
+    }
+    status = mtd.read_batch(r, n);
+    if (total != status)
+      return OSAL_FAILED;
+    for (size_t k=0; k<n; k++)
+      sum = nvramcrc(items[k], toc_item_len, sum);
+  }
 
-  return ret;
+  *result = sum;
+  return OSAL_SUCCESS;
 }
 
 /**
- * @brief   Recalculate and write checksum
+ * @brief   Write files count with recalculated checksum.
+ * @details When checksum follows files count (format V2) both are
+ *          written in single transaction.
+ *
+ * @return  OSAL_FAILED if TOC can not be read.
  */
-void Fs::seal(void){
-  uint8_t sum = 0xFF;
+bool Fs::seal(filecount_t cnt){
+  uint8_t hdr[sizeof(filecount_t) + sizeof(checksum_t)];
   size_t status;
 
-  osalDbgCheck((this->files_opened > 0) && (nullptr != super.mtd));
+  osalDbgCheck(nullptr != super.mtd);
 
-  super.setPosition(0);
-  status = super.read(toc_buf, FAT_OFFSET);
-  osalDbgCheck(FAT_OFFSET == status);
-  sum = nvramcrc(toc_buf, FAT_OFFSET, sum);
+  hdr[0] = cnt;
+  if (OSAL_SUCCESS != calc_checksum(cnt, &hdr[1]))
+    return OSAL_FAILED;
 
-  for (size_t i=0; i<NVRAM_FS_MAX_FILE_CNT; i++){
-    status = super.read(toc_buf, sizeof(toc_buf));
-    osalDbgCheck(sizeof(toc_buf) == status);
-    sum = nvramcrc(toc_buf, sizeof(toc_buf), sum);
+  if ((MAGIC_LEN + sizeof(filecount_t)) == csum_offset) {
+    status = super.setPosition(MAGIC_LEN);
+    osalDbgCheck(FILE_OK == status);
+    status = super.write(hdr, sizeof(hdr));
+    osalDbgCheck(sizeof(hdr) == status);
+  }
+  else {
+    write_file_cnt(cnt);
+    status = super.setPosition(csum_offset);
+    osalDbgCheck(FILE_OK == status);
+    status = super.write(&hdr[1], sizeof(checksum_t));
+    osalDbgCheck(sizeof(checksum_t) == status);
   }
 
-  /* store calculated sum */
-  status = super.write(&sum, sizeof(checksum_t));
-  osalDbgCheck(sizeof(checksum_t) == status);
+  return OSAL_SUCCESS;
 }
 
 /**
@@ -278,7 +452,7 @@ filecount_t Fs::get_file_cnt(void){
   filecount_t cnt;
   size_t status;
 
-  status = super.setPosition(sizeof(magic));
+  status = super.setPosition(MAGIC_LEN);
   osalDbgCheck(FILE_OK == status);
 
   status = super.read(&cnt, sizeof(filecount_t));
@@ -293,7 +467,7 @@ filecount_t Fs::get_file_cnt(void){
 void Fs::write_file_cnt(filecount_t N){
   size_t status;
 
-  status = super.setPosition(sizeof(magic));
+  status = super.setPosition(MAGIC_LEN);
   osalDbgCheck(FILE_OK == status);
 
   status = super.write(&N, 1);
@@ -305,32 +479,33 @@ void Fs::write_file_cnt(filecount_t N){
  */
 void Fs::read_toc_item(toc_item_t *result, size_t N){
   size_t status;
-  const size_t blocklen = sizeof(toc_item_t);
+  const size_t blocklen = toc_item_len;
 
   osalDbgCheck(N < NVRAM_FS_MAX_FILE_CNT);
 
-  status = super.setPosition(FAT_OFFSET + N * blocklen);
+  status = super.setPosition(toc_offset + N * toc_stride);
   osalDbgCheck(FILE_OK == status);
 
-  status = super.read((uint8_t *)result, blocklen);
+  status = super.read(toc_buf, blocklen);
   osalDbgCheck(blocklen == status);
+  toc_decode(result, toc_buf);
 }
 
 /**
- *
+ * @brief   Write TOC item. Files count and checksum must be updated
+ *          by seal() after it.
  */
 void Fs::write_toc_item(const toc_item_t *ti, size_t N){
   size_t status;
-  const size_t blocklen = sizeof(toc_item_t);
+  const size_t blocklen = toc_item_len;
 
   osalDbgCheck(N < NVRAM_FS_MAX_FILE_CNT);
 
-  status = super.setPosition(FAT_OFFSET + N * blocklen);
+  status = super.setPosition(toc_offset + N * toc_stride);
   osalDbgCheck(FILE_OK == status);
-  status = super.write((uint8_t *)ti, blocklen);
+  toc_encode(ti, toc_buf);
+  status = super.write(toc_buf, blocklen);
   osalDbgCheck(blocklen == status);
-
-  write_file_cnt(N + 1);
 }
 
 /**
@@ -338,47 +513,54 @@ void Fs::write_toc_item(const toc_item_t *ti, size_t N){
  */
 bool Fs::fsck(void) {
   fileoffset_t first_empty_byte;
-  uint8_t sum = 0xFF;
   filecount_t exists;
-  size_t status;
-
-  mtd.read(dbg_super, sizeof(dbg_super), 0);
+  checksum_t sum, calc;
+  read_range_t hdr[2];
+  size_t fmt;
 
-  /* open superblock */
+  /* open superblock. Magic is placed at the same offset in all formats */
   osalDbgCheck((this->files_opened == 0) && (nullptr == super.mtd));
+  select_format(FS_FORMAT_V0);
   open_super();
 
-  /* check magic */
+  /* check magic and detect format */
   get_magic(toc_buf);
-  sum = nvramcrc(toc_buf, sizeof(magic), sum);
-  if (0 != memcmp(magic, toc_buf, sizeof(magic)))
+  for (fmt=0; fmt<FORMAT_CNT; fmt++) {
+    if (0 == memcmp(magic[fmt], toc_buf, MAGIC_LEN))
+      break;
+  }
+  if (FORMAT_CNT == fmt)
+    goto FAILED;
+  select_format(static_cast<fs_format_t>(fmt));
+  open_super();
+
+  /* read files number and check sum at once */
+  hdr[0].buf = reinterpret_cast<uint8_t *>(&exists);
+  hdr[0].len = sizeof(filecount_t);
+  hdr[0].offset = super.start + MAGIC_LEN;
+  hdr[1].buf = reinterpret_cast<uint8_t *>(&sum);
+  hdr[1].len = sizeof(checksum_t);
+  hdr[1].offset = super.start + csum_offset;
+  if ((sizeof(filecount_t) + sizeof(checksum_t)) != mtd.read_batch(hdr, 2))
     goto FAILED;
 
   /* check existing files number */
-  exists = get_file_cnt();
-  sum = nvramcrc(&exists, sizeof(exists), sum);
   if (exists > NVRAM_FS_MAX_FILE_CNT)
     goto FAILED;
 
   /* verify check sum */
-  for (size_t i=0; i<NVRAM_FS_MAX_FILE_CNT; i++){
-    status = super.read(toc_buf, sizeof(toc_buf));
-    osalDbgCheck(sizeof(toc_buf) == status);
-    sum = nvramcrc(toc_buf, sizeof(toc_buf), sum);
-  }
-  if (sum != get_checksum())
+  if ((OSAL_SUCCESS != calc_checksum(exists, &calc)) || (calc != sum))
     goto FAILED;
 
   /* verify file names */
   first_empty_byte = super.start + super.size;
-  super.setPosition(FAT_OFFSET);
   for (size_t i=0; i<exists; i++){
     toc_item_t ti;
     read_toc_item(&ti, i);
 
     if (OSAL_FAILED == check_name(ti.name, NVRAM_FS_MAX_FILE_NAME_LEN))
       goto FAILED;
-    if ((ti.start + ti.size) >= mtd.capacity())
+    if ((ti.start > space_limit()) || (ti.size > space_limit() - ti.start))
       goto FAILED;
     if (ti.start < first_empty_byte)
       goto FAILED;
@@ -404,7 +586,7 @@ Fs::Fs(MtdBase &mtd) :
 mtd(mtd),
 files_opened(0)
 {
-  return;
+  select_format(FS_FORMAT_DEFAULT);
 }
 
 /**
@@ -423,10 +605,17 @@ bool Fs::mount(void) {
   open_super();
 
   this->files_opened = 1;
+
+  /* finish interrupted transaction */
+  if (OSAL_SUCCESS != open_journal())
+    goto FAILED;
+
   return OSAL_SUCCESS;
 
 FAILED:
   this->files_opened = 0;
+  journal.detach();
+  jfile.close();
   super.close();
   return OSAL_FAILED;
 }
@@ -440,6 +629,8 @@ bool Fs::umount(void) {
   if (this->files_opened > 1)
     return OSAL_FAILED;
   else{
+    journal.detach();
+    jfile.close();
     super.close();
     this->files_opened = 0;
     return OSAL_SUCCESS;
@@ -462,9 +653,9 @@ int Fs::find(const char *name, toc_item_t *ti){
 }
 
 /**
- *
+ * @brief   Allocate space and write TOC item for new file.
  */
-File* Fs::create(const char *name, uint32_t size){
+bool Fs::make_file(const char *name, uint32_t size, uint32_t align){
   toc_item_t ti;
   int id = -1;
   size_t file_cnt;
@@ -473,42 +664,163 @@ File* Fs::create(const char *name, uint32_t size){
 
   /* zero size forbidden */
   if (0 == size)
-    return nullptr;
+    return OSAL_FAILED;
 
   file_cnt = get_file_cnt();
 
   /* check are we have spare slot for file */
   if (NVRAM_FS_MAX_FILE_CNT == file_cnt)
-    return nullptr;
+    return OSAL_FAILED;
 
   id = find(name, &ti);
   if (-1 != id)
-    return nullptr; /* such file already exists */
+    return OSAL_FAILED; /* such file already exists */
 
   /* check for name length */
   if (strlen(name) >= NVRAM_FS_MAX_FILE_NAME_LEN)
-    return nullptr;
+    return OSAL_FAILED;
 
   /* there is no such file. Lets create it*/
   strncpy(ti.name, name, NVRAM_FS_MAX_FILE_NAME_LEN);
   ti.size = size;
-  if (0 != file_cnt){
-    toc_item_t tiprev;
-    read_toc_item(&tiprev, file_cnt - 1);
-    ti.start = tiprev.start + tiprev.size;
-  }
-  else
-    ti.start = super.size + super.start;
+  ti.start = align_up(first_free_byte(), align);
 
-  if ((ti.size + ti.start) > mtd.capacity())
-    return nullptr;
+  /* file must fit in space and its start in TOC field */
+  if ((ti.start > space_limit()) || (ti.size > space_limit() - ti.start))
+    return OSAL_FAILED;
+  if ((extent_len < sizeof(uint32_t)) && (0 != (ti.start >> (8 * extent_len))))
+    return OSAL_FAILED;
 
   /* */
   write_toc_item(&ti, file_cnt);
-  seal();
+  return seal(file_cnt + 1);
+}
+
+/**
+ *
+ */
+bool Fs::is_reserved(const char *name){
+  return 0 == strncmp(name, NVRAM_FS_JOURNAL_NAME, NVRAM_FS_MAX_FILE_NAME_LEN);
+}
+
+/**
+ *
+ */
+File* Fs::create(const char *name, uint32_t size, uint32_t align){
+
+  if (is_reserved(name))
+    return nullptr;
+
+  if (OSAL_SUCCESS != make_file(name, size, align))
+    return nullptr;
+
   return open(name);
 }
 
+/**
+ * @brief   Attach journal file (if any) and replay committed transaction.
+ */
+bool Fs::open_journal(void){
+  toc_item_t ti;
+
+  if (-1 == find(NVRAM_FS_JOURNAL_NAME, &ti))
+    return OSAL_SUCCESS; /* journal not created */
+
+  jfile.mtd = &mtd;
+  jfile.journal = nullptr;
+  jfile.tip = 0;
+  jfile.start = ti.start;
+  jfile.size = ti.size;
+  jfile.cache_len = 0;
+  jfile.cache_dirty = false;
+  journal.attach(&jfile, &mtd);
+
+  return journal.replay();
+}
+
+/**
+ * @brief   Create journal file needed for transactions.
+ * @note    Journal must hold all data written during single transaction
+ *          plus 6 bytes per every write call plus one page.
+ */
+bool Fs::mkjournal(uint32_t size){
+  toc_item_t ti;
+
+  osalDbgAssert(this->files_opened > 0, "FS not mounted");
+
+  if (-1 != find(NVRAM_FS_JOURNAL_NAME, &ti))
+    return OSAL_FAILED;
+
+  if (OSAL_SUCCESS != make_file(NVRAM_FS_JOURNAL_NAME, size, ALIGN_PAGE))
+    return OSAL_FAILED;
+
+  return open_journal();
+}
+
+/**
+ * @brief   Start transaction.
+ * @details All writes to files of this file system are logged to journal
+ *          until commit() or abort(). Reads inside transaction return
+ *          data written before begin().
+ */
+bool Fs::begin(void){
+  osalDbgAssert(this->files_opened > 0, "FS not mounted");
+
+  /* pending bytes belong to previous state */
+  for (size_t i=0; i<NVRAM_FS_MAX_FILE_CNT; i++) {
+    if (nullptr != fat[i].mtd)
+      fat[i].flush();
+  }
+
+  return journal.begin();
+}
+
+/**
+ * @brief   Atomically apply all writes made since begin().
+ */
+bool Fs::commit(void){
+  osalDbgAssert(this->files_opened > 0, "FS not mounted");
+
+  for (size_t i=0; i<NVRAM_FS_MAX_FILE_CNT; i++) {
+    if (nullptr != fat[i].mtd)
+      fat[i].flush();
+  }
+
+  return journal.commit();
+}
+
+/**
+ * @brief   Special commit for testing. Do not use it.
+ * @details Leaves journal committed but not applied, like reset
+ *          right after commit record.
+ */
+bool Fs::__test_commit_crash(void){
+  osalDbgAssert(this->files_opened > 0, "FS not mounted");
+
+  for (size_t i=0; i<NVRAM_FS_MAX_FILE_CNT; i++) {
+    if (nullptr != fat[i].mtd)
+      fat[i].flush();
+  }
+
+  return journal.__test_commit_crash();
+}
+
+/**
+ * @brief   Drop all writes made since begin().
+ */
+void Fs::abort(void){
+  osalDbgAssert(this->files_opened > 0, "FS not mounted");
+
+  for (size_t i=0; i<NVRAM_FS_MAX_FILE_CNT; i++) {
+    if (nullptr != fat[i].mtd) {
+      fat[i].cache_dirty = false;
+      fat[i].cache_len = 0;
+    }
+  }
+
+  journal.abort();
+}
+
 /**
  *
  */
@@ -518,6 +830,9 @@ File* Fs::open(const char *name){
 
   osalDbgAssert(this->files_opened > 0, "FS not mounted");
 
+  if (is_reserved(name))
+    return nullptr;
+
   id = find(name, &ti);
 
   if (-1 == id)
@@ -529,6 +844,7 @@ File* Fs::open(const char *name){
   fat[id].size = ti.size;
   fat[id].start = ti.start;
   fat[id].mtd = &mtd;
+  fat[id].journal = &journal;
   this->files_opened++;
 
   return &fat[id];
@@ -553,23 +869,30 @@ void Fs::close(File *file) {
   this->files_opened--;
 }
 
+/**
+ * @brief   Return superblock format of mounted file system.
+ */
+fs_format_t Fs::get_format(void) {
+  osalDbgAssert(this->files_opened > 0, "FS not mounted");
+  return this->format;
+}
+
 /**
  * @brief   Return free disk space
+ *
+ * @param[in] align   alignment of the next file as passed to create().
+ *                    Space wasted for padding is not counted as free.
  */
-uint32_t Fs::df(void) {
-  toc_item_t ti;
-  size_t file_cnt;
+uint32_t Fs::df(uint32_t align) {
+  uint32_t start;
 
   osalDbgAssert(this->files_opened > 0, "FS not mounted");
 
-  file_cnt = get_file_cnt();
-  if (file_cnt > 0) {
-    read_toc_item(&ti, file_cnt - 1);
-    return mtd.capacity() - (ti.size + ti.start);
-  }
-  else {
-    return mtd.capacity() - (super.size + super.start);
-  }
+  start = align_up(first_free_byte(), align);
+  if (start >= space_limit())
+    return 0;
+  else
+    return space_limit() - start;
 }
 
 } /* namespace */
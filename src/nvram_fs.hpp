@@ -25,11 +25,37 @@
 
 #include "mtd_base.hpp"
 #include "nvram_file.hpp"
+#include "nvram_journal.hpp"
 
 #include "nvram_fs_conf.h"
 
 namespace nvram {
 
+/**
+ * @brief   On-device superblock layouts.
+ */
+enum fs_format_t {
+  /**
+   * Legacy layout. File start and size are 16-bit, so files can not be
+   * placed beyond 64 kB. Supported for mounting existing devices.
+   */
+  FS_FORMAT_V0 = 0,
+  /**
+   * File start and size are 32-bit. Superblock is packed, so single TOC
+   * item may straddle page boundary.
+   */
+  FS_FORMAT_V1,
+  /**
+   * Same as V1 but header and every TOC item are padded to page
+   * boundary. Any metadata update costs exactly one page program.
+   */
+  FS_FORMAT_V2,
+  /**
+   * Format used by mkfs() by default.
+   */
+  FS_FORMAT_DEFAULT = FS_FORMAT_V2,
+};
+
 /**
  *
  */
@@ -47,11 +73,11 @@ struct __attribute__((packed)) toc_item_t {
   /**
    * Start of file
    */
-  uint16_t start;
+  uint32_t start;
   /**
    * Size of file
    */
-  uint16_t size;
+  uint32_t size;
 };
 
 /**
@@ -64,35 +90,73 @@ typedef uint8_t filecount_t;
  */
 typedef uint8_t checksum_t;
 
+/**
+ * @brief   Helpers shared by file system and journal.
+ */
+uint8_t nvramcrc(const uint8_t *buf, size_t len, uint8_t crc);
+void pack_le(uint8_t *buf, uint32_t v, size_t len);
+uint32_t unpack_le(const uint8_t *buf, size_t len);
+
 /**
  *
  */
 class Fs {
 public:
+  /**
+   * @brief   Align file start to device page size.
+   * @details Page aligned file of page sized records writes every record
+   *          in single program cycle.
+   */
+  static const uint32_t ALIGN_PAGE = 0;
   Fs(MtdBase &mtd);
   File *open(const char *name);
   void close(File *file);
-  File *create(const char *name, uint32_t size);
+  File *create(const char *name, uint32_t size, uint32_t align = 1);
   bool mount(void);
   bool is_mounted(void);
   bool umount(void);
-  bool mkfs(void);
+  bool mkfs(fs_format_t format = FS_FORMAT_DEFAULT);
   bool fsck(void);
-  uint32_t df(void);
+  uint32_t df(uint32_t align = 1);
+  fs_format_t get_format(void);
+  bool mkjournal(uint32_t size);
+  bool begin(void);
+  bool commit(void);
+  void abort(void);
+  bool __test_commit_crash(void);
 private:
-  checksum_t get_checksum(void);
+  bool make_file(const char *name, uint32_t size, uint32_t align);
+  bool open_journal(void);
+  bool is_reserved(const char *name);
+  void select_format(fs_format_t format);
+  void toc_encode(const toc_item_t *ti, uint8_t *buf);
+  void toc_decode(toc_item_t *ti, const uint8_t *buf);
+  uint32_t space_limit(void);
+  uint32_t first_free_byte(void);
+  uint32_t align_up(uint32_t addr, uint32_t align);
+  bool calc_checksum(filecount_t cnt, checksum_t *result);
   filecount_t get_file_cnt(void);
   void write_file_cnt(filecount_t cnt);
   void get_magic(uint8_t *result);
   void read_toc_item(toc_item_t *result, size_t num);
   void write_toc_item(const toc_item_t *result, size_t num);
   void open_super(void);
-  void seal(void);
+  bool seal(filecount_t cnt);
   int find(const char *name, toc_item_t *ti);
   MtdBase &mtd;
   File super;
   File fat[NVRAM_FS_MAX_FILE_CNT];
+  File jfile;
+  Journal journal;
   uint8_t toc_buf[sizeof(toc_item_t)];
+  /* Layout of mounted (or being created) file system. */
+  fs_format_t format;
+  size_t extent_len;    /* size of start and size fields in TOC item */
+  size_t toc_item_len;  /* size of single TOC item on device */
+  size_t toc_offset;    /* offset of the first TOC item */
+  size_t toc_stride;    /* distance between TOC items including padding */
+  size_t csum_offset;   /* offset of checksum */
+  size_t sb_size;       /* size of whole superblock */
   /* Counter for opened files. In unmounted state this value must be 0.
    * After mounting it must be set to 1 denoting successful mount. Every
    * 'open' must increment it and every 'close' must decrement it. */
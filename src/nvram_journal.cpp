@@ -0,0 +1,373 @@
+/*
+    Abstraction layer for EEPROM ICs.
+
+    Copyright (C) 2012..2016 Uladzimir Pylinski aka barthess
+
+    This file is part of 24AA lib.
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include <cstring>
+
+#include "nvram_fs.hpp"
+#include "nvram_journal.hpp"
+
+using namespace chibios_fs;
+
+namespace nvram {
+
+/*
+ ******************************************************************************
+ * DEFINES
+ ******************************************************************************
+ */
+
+#if NVRAM_FS_JOURNAL_BUF_SIZE < 16
+#error "NVRAM_FS_JOURNAL_BUF_SIZE must be at least 16"
+#endif
+
+/*
+ ******************************************************************************
+ * EXTERNS
+ ******************************************************************************
+ */
+
+/*
+ ******************************************************************************
+ * PROTOTYPES
+ ******************************************************************************
+ */
+
+/*
+ ******************************************************************************
+ * GLOBAL VARIABLES
+ ******************************************************************************
+ */
+
+/**
+ *
+ */
+static const uint8_t jmagic[] = {'j','r','n','l'};
+
+/**
+ * @brief   Commit record: magic, payload length, payload CRC, record CRC.
+ */
+static const size_t RECORD_LEN = sizeof(jmagic) + sizeof(uint32_t) + 2;
+
+/**
+ * @brief   Entry header: destination offset and data length.
+ */
+static const size_t ENTRY_HDR_LEN = sizeof(uint32_t) + sizeof(uint16_t);
+
+/**
+ *
+ */
+static const size_t ENTRY_MAX_LEN = 0xFFFF;
+
+/*
+ ******************************************************************************
+ ******************************************************************************
+ * LOCAL FUNCTIONS
+ ******************************************************************************
+ ******************************************************************************
+ */
+
+/**
+ * @brief   Write commit record of active transaction.
+ */
+bool Journal::write_record(void) {
+
+  /* all entries must be on device before commit record */
+  if (OSAL_SUCCESS != file->flush())
+    return OSAL_FAILED;
+
+  memcpy(buf, jmagic, sizeof(jmagic));
+  pack_le(&buf[sizeof(jmagic)], length, sizeof(uint32_t));
+  buf[RECORD_LEN - 2] = crc;
+  buf[RECORD_LEN - 1] = nvramcrc(buf, RECORD_LEN - 1, 0xFF);
+  if (FILE_OK != file->setPosition(0))
+    return OSAL_FAILED;
+  if (RECORD_LEN != file->write(buf, RECORD_LEN))
+    return OSAL_FAILED;
+
+  return OSAL_SUCCESS;
+}
+
+/**
+ * @brief   Read and validate commit record.
+ */
+bool Journal::read_record(uint32_t *len, uint8_t *payload_crc) {
+
+  if (FILE_OK != file->setPosition(0))
+    return OSAL_FAILED;
+  if (RECORD_LEN != file->read(buf, RECORD_LEN))
+    return OSAL_FAILED;
+
+  if (0 != memcmp(buf, jmagic, sizeof(jmagic)))
+    return OSAL_FAILED;
+  if (buf[RECORD_LEN - 1] != nvramcrc(buf, RECORD_LEN - 1, 0xFF))
+    return OSAL_FAILED;
+
+  *len = unpack_le(&buf[sizeof(jmagic)], sizeof(uint32_t));
+  *payload_crc = buf[RECORD_LEN - 2];
+  if (*len > file->getSize() - data_offset)
+    return OSAL_FAILED;
+
+  return OSAL_SUCCESS;
+}
+
+/**
+ *
+ */
+bool Journal::check_payload(uint32_t len, uint8_t payload_crc) {
+  uint8_t sum = 0xFF;
+
+  if (FILE_OK != file->setPosition(data_offset))
+    return OSAL_FAILED;
+
+  while (len > 0) {
+    size_t n = (len > sizeof(buf)) ? sizeof(buf) : len;
+    if (n != file->read(buf, n))
+      return OSAL_FAILED;
+    sum = nvramcrc(buf, n, sum);
+    len -= n;
+  }
+
+  if (sum != payload_crc)
+    return OSAL_FAILED;
+  else
+    return OSAL_SUCCESS;
+}
+
+/**
+ * @brief   Copy journaled data to its home location.
+ * @details Data is moved by device internal copy, so every destination
+ *          page costs single program.
+ * @note    Idempotent, so it is safe to run it again after reset.
+ */
+bool Journal::apply(uint32_t len) {
+  const uint32_t base = file->start + data_offset;
+  uint32_t pos = 0;
+
+  while (pos < len) {
+    uint32_t dst;
+    size_t n;
+
+    if (FILE_OK != file->setPosition(data_offset + pos))
+      return OSAL_FAILED;
+    if (ENTRY_HDR_LEN != file->read(buf, ENTRY_HDR_LEN))
+      return OSAL_FAILED;
+    dst = unpack_le(buf, sizeof(uint32_t));
+    n = unpack_le(&buf[sizeof(uint32_t)], sizeof(uint16_t));
+    pos += ENTRY_HDR_LEN;
+    if ((pos + n > len) || (dst + n > mtd->capacity()))
+      return OSAL_FAILED;
+
+    if (n != mtd->copy(base + pos, dst, n))
+      return OSAL_FAILED;
+    pos += n;
+  }
+
+  return OSAL_SUCCESS;
+}
+
+/**
+ * @brief   Invalidate commit record.
+ */
+bool Journal::clear(void) {
+
+  memset(buf, 0, sizeof(jmagic));
+  if (FILE_OK != file->setPosition(0))
+    return OSAL_FAILED;
+  if (sizeof(jmagic) != file->write(buf, sizeof(jmagic)))
+    return OSAL_FAILED;
+
+  return OSAL_SUCCESS;
+}
+
+/**
+ *
+ */
+void Journal::attach(File *file, MtdBase *mtd) {
+  uint32_t ps;
+
+  this->file = file;
+  this->mtd = mtd;
+  this->active = false;
+
+  /* commit record occupies its own page */
+  ps = (mtd->pagecount() > 1) ? mtd->pagesize() : 1;
+  data_offset = ((RECORD_LEN + ps - 1) / ps) * ps;
+  osalDbgCheck(file->getSize() > data_offset);
+}
+
+/**
+ *
+ */
+void Journal::detach(void) {
+  abort();
+  file = nullptr;
+  mtd = nullptr;
+}
+
+/**
+ * @brief   Start new transaction.
+ */
+bool Journal::begin(void) {
+
+  if ((nullptr == file) || active)
+    return OSAL_FAILED;
+
+  if (FILE_OK != file->setPosition(data_offset))
+    return OSAL_FAILED;
+
+  length = 0;
+  crc = 0xFF;
+  failed = false;
+  active = true;
+  return OSAL_SUCCESS;
+}
+
+/**
+ * @brief   Log data destined to absolute device offset.
+ * @details Header and data of every entry go to device by single
+ *          gathered write, i.e. by page sized transactions.
+ * @return  Number of accepted bytes.
+ */
+size_t Journal::append(const uint8_t *data, size_t len, uint32_t offset) {
+  uint8_t hdr[ENTRY_HDR_LEN];
+  iovec_t iov[2];
+  size_t done = 0;
+
+  osalDbgCheck(active);
+
+  while ((done < len) && !failed) {
+    size_t n = len - done;
+    if (n > ENTRY_MAX_LEN)
+      n = ENTRY_MAX_LEN;
+
+    pack_le(hdr, offset + done, sizeof(uint32_t));
+    pack_le(&hdr[sizeof(uint32_t)], n, sizeof(uint16_t));
+    iov[0].base = hdr;
+    iov[0].len  = sizeof(hdr);
+    iov[1].base = const_cast<uint8_t *>(&data[done]);
+    iov[1].len  = n;
+    if ((sizeof(hdr) + n) != file->writev(iov, 2)) {
+      failed = true; /* journal overflow or IO error */
+      return 0;
+    }
+    crc = nvramcrc(hdr, sizeof(hdr), crc);
+    crc = nvramcrc(&data[done], n, crc);
+    length += sizeof(hdr) + n;
+    done += n;
+  }
+
+  return done;
+}
+
+/**
+ * @brief   Make transaction durable and apply it.
+ */
+bool Journal::commit(void) {
+
+  if (!active)
+    return OSAL_FAILED;
+  active = false;
+
+  if (failed)
+    return OSAL_FAILED;
+  if (0 == length)
+    return OSAL_SUCCESS;
+
+  if (OSAL_SUCCESS != write_record())
+    return OSAL_FAILED;
+
+  /* transaction is durable now. In case of failure it will be
+   * replayed during next mount */
+  if (OSAL_SUCCESS != apply(length))
+    return OSAL_FAILED;
+
+  return clear();
+}
+
+/**
+ * @brief   Commit stopped right after commit record like by reset.
+ *          For testing only.
+ */
+bool Journal::__test_commit_crash(void) {
+
+  if (!active || failed || (0 == length))
+    return OSAL_FAILED;
+  active = false;
+
+  return write_record();
+}
+
+/**
+ * @brief   Drop active transaction. Nothing has been written to files yet.
+ */
+void Journal::abort(void) {
+  active = false;
+}
+
+/**
+ * @brief   Replay committed but not applied transaction.
+ */
+bool Journal::replay(void) {
+  uint32_t len;
+  uint8_t payload_crc;
+
+  if (nullptr == file)
+    return OSAL_SUCCESS;
+
+  if (OSAL_SUCCESS != read_record(&len, &payload_crc))
+    return OSAL_SUCCESS; /* nothing committed */
+
+  if (OSAL_SUCCESS == check_payload(len, payload_crc)) {
+    if (OSAL_SUCCESS != apply(len))
+      return OSAL_FAILED;
+  }
+
+  return clear();
+}
+
+/*
+ ******************************************************************************
+ * EXPORTED FUNCTIONS
+ ******************************************************************************
+ */
+
+/**
+ *
+ */
+Journal::Journal(void) :
+file(nullptr),
+mtd(nullptr),
+data_offset(0),
+length(0),
+crc(0xFF),
+active(false),
+failed(false)
+{
+  return;
+}
+
+/**
+ *
+ */
+bool Journal::is_active(void) {
+  return active;
+}
+
+} /* namespace */
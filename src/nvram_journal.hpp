@@ -0,0 +1,94 @@
+/*
+    Abstraction layer for EEPROM ICs.
+
+    Copyright (C) 2012..2016 Uladzimir Pylinski aka barthess
+
+    This file is part of 24AA lib.
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#ifndef NVRAM_JOURNAL_HPP_
+#define NVRAM_JOURNAL_HPP_
+
+#include "mtd_base.hpp"
+#include "nvram_file.hpp"
+
+#include "nvram_fs_conf.h"
+
+/**
+ * @brief   Name of file reserved for write ahead journal.
+ */
+#if !defined(NVRAM_FS_JOURNAL_NAME)
+#define NVRAM_FS_JOURNAL_NAME                   "jrnl"
+#endif
+
+/**
+ * @brief   Size of buffer used for journal replaying.
+ */
+#if !defined(NVRAM_FS_JOURNAL_BUF_SIZE)
+#define NVRAM_FS_JOURNAL_BUF_SIZE               32
+#endif
+
+namespace nvram {
+
+/**
+ * @brief   Write ahead journal making multi file updates atomic.
+ * @details Journal file layout:
+ *          - commit record padded to page boundary:
+ *            magic, payload length, payload CRC, record CRC.
+ *          - payload: sequence of entries, each one is absolute device
+ *            offset, data length and data itself.
+ *          Every entry is appended by single gathered write, so it
+ *          goes by page sized transactions. Single commit
+ *          record write makes the transaction durable. After that data
+ *          is copied to its home location and commit record is cleared.
+ * @note    Every page is programmed twice, in journal and at home, plus
+ *          commit record and its clear. So transaction costs 2..3 times
+ *          plain rewrite checked by read back, see txn_* benchmark. It
+ *          is the price of atomicity across files, which rewriting and
+ *          verifying one file after another can not give.
+ */
+class Journal {
+  friend class Fs;
+  friend class File;
+public:
+  Journal(void);
+  bool is_active(void);
+private:
+  void attach(File *file, MtdBase *mtd);
+  void detach(void);
+  bool begin(void);
+  bool commit(void);
+  bool __test_commit_crash(void);
+  void abort(void);
+  bool replay(void);
+  size_t append(const uint8_t *data, size_t len, uint32_t offset);
+  bool write_record(void);
+  bool read_record(uint32_t *len, uint8_t *crc);
+  bool check_payload(uint32_t len, uint8_t crc);
+  bool apply(uint32_t len);
+  bool clear(void);
+  File *file;
+  MtdBase *mtd;
+  uint32_t data_offset; /* payload start inside journal file */
+  uint32_t length;      /* payload length of active transaction */
+  uint8_t crc;          /* payload CRC of active transaction */
+  bool active;
+  bool failed;
+  uint8_t buf[NVRAM_FS_JOURNAL_BUF_SIZE];
+};
+
+} /* namespace */
+
+#endif /* NVRAM_JOURNAL_HPP_ */
@@ -30,6 +30,7 @@
 #include "nvram_file.hpp"
 #include "nvram_fs.hpp"
 #include "nvram_test_suite.hpp"
+#include "mtd_shadow.hpp"
 
 using namespace nvram;
 
@@ -39,6 +40,8 @@ using namespace nvram;
  ******************************************************************************
  */
 
+#define LOCK_TEST_ROUNDS      16
+
 /*
  ******************************************************************************
  * EXTERNS
@@ -57,6 +60,65 @@ using namespace nvram;
  ******************************************************************************
  */
 
+/**
+ * @brief   Shared state of lock test writer thread.
+ */
+struct lock_test_t {
+  MtdBase       *mtd;
+  uint8_t       *buf;
+  size_t        len;
+  chibios_rt::CounterSemaphore *done;
+  volatile bool run;
+  volatile size_t writes;
+};
+
+static THD_WORKING_AREA(lock_writer_wa, 512);
+
+#define BROKEN_MTD_SIZE       64
+
+/**
+ * @brief   Small FRAM like device rejecting every write. Reads as erased.
+ */
+class BrokenMtd : public MtdBase {
+public:
+  BrokenMtd(const MtdConfig &cfg) : MtdBase(cfg, writebuf, sizeof(writebuf)) {;}
+protected:
+  size_t bus_write(const uint8_t *txdata, size_t len, uint32_t offset) {
+    (void)txdata;
+    (void)len;
+    (void)offset;
+    return 0;
+  }
+  size_t bus_read(uint8_t *rxbuf, size_t len, uint32_t offset) {
+    (void)offset;
+    memset(rxbuf, 0xFF, len);
+    return len;
+  }
+private:
+  uint8_t writebuf[BROKEN_MTD_SIZE + 2];
+};
+
+static const MtdConfig broken_mtd_cfg = {
+    0,
+    0,
+    1,
+    BROKEN_MTD_SIZE,
+    2,
+    400000,
+    nullptr,
+    nullptr,
+    nullptr,
+    nullptr,
+    nullptr,
+    nullptr,
+    nullptr,
+    nullptr,
+    nullptr,
+    nullptr,
+    0,
+    0,
+};
+
 /*
  ******************************************************************************
  ******************************************************************************
@@ -494,6 +556,770 @@ static void full_write_erase(nvram::TestContext *ctx) {
   dbgprint(ctx, "OK\r\n");
 }
 
+/*
+ *
+ */
+static void __shadow_test(nvram::TestContext *ctx, bool writeback) {
+  static uint8_t dirtymap[128];
+  MtdBase *mtd = ctx->mtd;
+  MtdShadow shadow(*mtd, ctx->filebuf, dirtymap, writeback);
+  const size_t len = 3 * ctx->len / 8;
+  const uint32_t offset = ctx->len / 4 + 1;
+
+  osalDbgCheck(OSAL_SUCCESS == shadow.start());
+  osalDbgCheck(0 == shadow.dirty_count());
+
+  memset(ctx->refbuf, 0xA5 + writeback, len);
+  osalDbgCheck(len == shadow.write(ctx->refbuf, len, offset));
+  memset(ctx->mtdbuf, 0x55, len);
+  osalDbgCheck(len == shadow.read(ctx->mtdbuf, len, offset));
+  osalDbgCheck(0 == memcmp(ctx->refbuf, ctx->mtdbuf, len));
+
+  if (writeback) {
+    osalDbgCheck(0 != shadow.dirty_count());
+    osalDbgCheck(len == mtd->read(ctx->mtdbuf, len, offset));
+    osalDbgCheck(0 != memcmp(ctx->refbuf, ctx->mtdbuf, len));
+    osalDbgCheck(OSAL_SUCCESS == shadow.flush());
+    osalDbgCheck(0 == shadow.dirty_count());
+  }
+
+  osalDbgCheck(len == mtd->read(ctx->mtdbuf, len, offset));
+  osalDbgCheck(0 == memcmp(ctx->refbuf, ctx->mtdbuf, len));
+}
+
+/*
+ *
+ */
+static void __vector_io_test(nvram::TestContext *ctx, uint32_t offset) {
+  MtdBase *mtd = ctx->mtd;
+  uint8_t hdr[5];
+  const size_t len = ctx->len / 4;
+  iovec_t iov[3];
+
+  fill_random(ctx->refbuf, ctx->len);
+  memcpy(hdr, ctx->refbuf, sizeof(hdr));
+
+  iov[0] = {hdr, sizeof(hdr)};
+  iov[1] = {&ctx->refbuf[sizeof(hdr)], 0};
+  iov[2] = {&ctx->refbuf[sizeof(hdr)], len - sizeof(hdr)};
+  osalDbgCheck(len == mtd->writev(iov, 3, offset));
+
+  memset(ctx->mtdbuf, 0x55, len);
+  osalDbgCheck(len == mtd->read(ctx->mtdbuf, len, offset));
+  osalDbgCheck(0 == memcmp(ctx->refbuf, ctx->mtdbuf, len));
+
+  memset(ctx->mtdbuf, 0x55, len);
+  iov[0] = {ctx->mtdbuf, 1};
+  iov[1] = {&ctx->mtdbuf[1], len / 2};
+  iov[2] = {&ctx->mtdbuf[1 + len / 2], len - 1 - len / 2};
+  osalDbgCheck(len == mtd->readv(iov, 3, offset));
+  osalDbgCheck(0 == memcmp(ctx->refbuf, ctx->mtdbuf, len));
+}
+
+/*
+ *
+ */
+static void vector_io_test(nvram::TestContext *ctx) {
+  dbgprint(ctx, "writev/readv test ... ");
+  __vector_io_test(ctx, 0);
+  __vector_io_test(ctx, 3);
+  if (! ctx->mtd->is_fram())
+    __vector_io_test(ctx, ctx->mtd->pagesize() - 2);
+  osalDbgCheck(MSG_OK == nvramset(ctx, 0xFF));
+  dbgprint(ctx, "OK\r\n");
+}
+
+/*
+ *
+ */
+static void read_batch_test(nvram::TestContext *ctx) {
+  MtdBase *mtd = ctx->mtd;
+  const uint32_t len = ctx->len / 2;
+  uint8_t buf[5][8];
+  read_range_t r[5];
+  /* unsorted, overlapped, adjacent and far away ranges */
+  const uint32_t off[5] = {len - 8, 40, 3, 11, 44};
+  const size_t   sz[5]  = {8, 8, 8, 2, 6};
+
+  dbgprint(ctx, "read batch test ... ");
+
+  fill_random(ctx->refbuf, ctx->len);
+  osalDbgCheck(len == mtd->write(ctx->refbuf, len, 0));
+
+  memset(buf, 0x55, sizeof(buf));
+  for (size_t i=0; i<5; i++) {
+    r[i].buf = buf[i];
+    r[i].len = sz[i];
+    r[i].offset = off[i];
+  }
+  osalDbgCheck(32 == mtd->read_batch(r, 5));
+
+  for (size_t i=0; i<5; i++) {
+    osalDbgCheck((i == 0) || (r[i-1].offset <= r[i].offset));
+    osalDbgCheck(0 == memcmp(r[i].buf, &ctx->refbuf[r[i].offset], r[i].len));
+  }
+
+  osalDbgCheck(MSG_OK == nvramset(ctx, 0xFF));
+  dbgprint(ctx, "OK\r\n");
+}
+
+/*
+ *
+ */
+struct stream_ctx_t {
+  const uint8_t *ref;
+  size_t        pos;
+  size_t        stop;
+};
+
+static bool stream_consumer(const uint8_t *data, size_t len, void *arg) {
+  stream_ctx_t *sc = static_cast<stream_ctx_t *>(arg);
+
+  osalDbgCheck(0 == memcmp(&sc->ref[sc->pos], data, len));
+  sc->pos += len;
+  if (sc->pos >= sc->stop)
+    return OSAL_FAILED;
+  else
+    return OSAL_SUCCESS;
+}
+
+/*
+ *
+ */
+static void read_stream_test(nvram::TestContext *ctx) {
+  MtdBase *mtd = ctx->mtd;
+  const size_t len = ctx->len / 2;
+  const uint32_t offset = 5;
+  uint8_t chunk[7];
+  stream_ctx_t sc;
+
+  dbgprint(ctx, "read stream test ... ");
+
+  fill_random(ctx->refbuf, ctx->len);
+  osalDbgCheck(len == mtd->write(ctx->refbuf, len, offset));
+
+  /* whole region */
+  sc = {ctx->refbuf, 0, len};
+  osalDbgCheck(len == mtd->read_stream(chunk, sizeof(chunk), len, offset,
+                                       stream_consumer, &sc));
+  osalDbgCheck(len == sc.pos);
+
+  /* consumer stops stream */
+  sc = {ctx->refbuf, 0, 10};
+  osalDbgCheck(14 == mtd->read_stream(chunk, sizeof(chunk), len, offset,
+                                      stream_consumer, &sc));
+
+  osalDbgCheck(MSG_OK == nvramset(ctx, 0xFF));
+  dbgprint(ctx, "OK\r\n");
+}
+
+/*
+ *
+ */
+static void __copy_test(nvram::TestContext *ctx, uint32_t src, uint32_t dst,
+                        size_t len, uint8_t *buf = nullptr, size_t buflen = 0) {
+  MtdBase *mtd = ctx->mtd;
+
+  osalDbgCheck(len == mtd->copy(src, dst, len, buf, buflen));
+  memmove(&ctx->refbuf[dst], &ctx->refbuf[src], len);
+
+  memset(ctx->mtdbuf, 0x55, ctx->len);
+  osalDbgCheck(ctx->len == mtd->read(ctx->mtdbuf, ctx->len, 0));
+  osalDbgCheck(0 == memcmp(ctx->refbuf, ctx->mtdbuf, ctx->len));
+}
+
+/*
+ *
+ */
+static void copy_test(nvram::TestContext *ctx) {
+  MtdBase *mtd = ctx->mtd;
+  const size_t N = ctx->len;
+
+  dbgprint(ctx, "copy test ... ");
+
+  fill_random(ctx->refbuf, N);
+  osalDbgCheck(N == mtd->write(ctx->refbuf, N, 0));
+
+  __copy_test(ctx, 0, N/2, N/4);          /* disjoint */
+  __copy_test(ctx, 3, 10, N/2);           /* overlap, backward */
+  __copy_test(ctx, N/2 + 1, N/4 - 3, N/3);/* overlap, forward */
+  __copy_test(ctx, 7, 7, 20);             /* in place */
+  __copy_test(ctx, N - 1, 0, 1);          /* single byte */
+
+  /* through caller's buffer, not multiple of page */
+  __copy_test(ctx, 0, N/2, N/4, ctx->filebuf, 333);
+  __copy_test(ctx, 3, 10, N/2, ctx->filebuf, 333);
+  __copy_test(ctx, N/2 + 1, N/4 - 3, N/3, ctx->filebuf, 333);
+  __copy_test(ctx, 5, 1000, 1000, ctx->filebuf, 1000);
+  __copy_test(ctx, 7, 7, 20, ctx->filebuf, 333);
+  /* too small buffer falls back to write buffer */
+  __copy_test(ctx, 11, N/2, 300, ctx->filebuf, 8);
+
+  osalDbgCheck(MSG_OK == nvramset(ctx, 0xFF));
+  dbgprint(ctx, "OK\r\n");
+}
+
+/*
+ * Matched prefix length of device range computed by plain read.
+ */
+static size_t read_match(nvram::TestContext *ctx, uint32_t offset,
+                         const uint8_t *data, size_t len) {
+  size_t i;
+
+  memset(ctx->mtdbuf, 0x55, len);
+  osalDbgCheck(len == ctx->mtd->read(ctx->mtdbuf, len, offset));
+  for (i=0; i<len; i++) {
+    if (ctx->mtdbuf[i] != ((nullptr == data) ? 0xFF : data[i]))
+      break;
+  }
+  return i;
+}
+
+/*
+ *
+ */
+static void __blank_test(nvram::TestContext *ctx, uint32_t offset,
+                         size_t len, bool expect) {
+  const bool blank = ctx->mtd->is_blank(offset, len);
+
+  osalDbgCheck(expect == blank);
+  osalDbgCheck(blank == (len == read_match(ctx, offset, nullptr, len)));
+}
+
+/*
+ *
+ */
+static void __compare_test(nvram::TestContext *ctx, uint32_t offset,
+                           const uint8_t *data, size_t len, size_t expect) {
+  const size_t same = ctx->mtd->compare(offset, data, len);
+
+  osalDbgCheck(expect == same);
+  osalDbgCheck(same == read_match(ctx, offset, data, len));
+}
+
+/*
+ *
+ */
+static void blank_compare_test(nvram::TestContext *ctx) {
+  MtdBase *mtd = ctx->mtd;
+  const size_t N = ctx->len - 4; /* offset + N fits in buffer */
+  const uint32_t offset = 3;
+  const uint8_t one = 0x7F;
+
+  dbgprint(ctx, "blank and compare test ... ");
+
+  osalDbgCheck(MSG_OK == nvramset(ctx, 0xFF));
+  check_erased(ctx);
+  osalDbgCheck(mtd->is_blank(0, mtd->capacity()));
+
+  /* single programmed byte at both ends and in the middle */
+  osalDbgCheck(1 == mtd->write(&one, 1, offset + N - 1));
+  __blank_test(ctx, offset, N - 1, true);
+  __blank_test(ctx, offset, N, false);
+  __blank_test(ctx, offset + N - 1, 1, false);
+  __blank_test(ctx, offset + N/2, N/2, false);
+
+  fill_random(ctx->refbuf, N);
+  osalDbgCheck(N == mtd->write(ctx->refbuf, N, offset));
+  __compare_test(ctx, offset, ctx->refbuf, N, N);
+  __compare_test(ctx, offset + 5, &ctx->refbuf[5], N - 5, N - 5);
+
+  ctx->refbuf[N/2] ^= 1;
+  __compare_test(ctx, offset, ctx->refbuf, N, N/2);
+  ctx->refbuf[0] ^= 1;
+  __compare_test(ctx, offset, ctx->refbuf, N, 0);
+
+  osalDbgCheck(MSG_OK == nvramset(ctx, 0xFF));
+  dbgprint(ctx, "OK\r\n");
+}
+
+/*
+ *
+ */
+static void __fill_test(nvram::TestContext *ctx, uint32_t offset, size_t len,
+                        uint8_t pattern) {
+  MtdBase *mtd = ctx->mtd;
+
+  osalDbgCheck(len == mtd->fill(offset, len, pattern));
+  memset(&ctx->refbuf[offset], pattern, len);
+
+  memset(ctx->mtdbuf, 0x55, ctx->len);
+  osalDbgCheck(ctx->len == mtd->read(ctx->mtdbuf, ctx->len, 0));
+  osalDbgCheck(0 == memcmp(ctx->refbuf, ctx->mtdbuf, ctx->len));
+}
+
+/*
+ *
+ */
+static void fill_test(nvram::TestContext *ctx) {
+  MtdBase *mtd = ctx->mtd;
+  const size_t N = ctx->len;
+
+  dbgprint(ctx, "fill test ... ");
+
+  fill_random(ctx->refbuf, N);
+  osalDbgCheck(N == mtd->write(ctx->refbuf, N, 0));
+
+  __fill_test(ctx, 0, N/2, 0xA5);
+  __fill_test(ctx, 3, N/3, 0x00);
+  __fill_test(ctx, N/2 - 1, N/2 + 1, 0xFF);
+  __fill_test(ctx, N - 1, 1, 0x5A);
+
+#if MTD_USE_STATS
+  /* already filled pages must be skipped */
+  if (! mtd->is_fram()) {
+    MtdStats st;
+    const uint32_t es = mtd->erasesize();
+    const uint32_t pages = (N + mtd->pagesize() - 1) / mtd->pagesize();
+    mtd->stats_reset();
+    osalDbgCheck(N == mtd->fill(0, N, 0x77));
+    osalDbgCheck(N == mtd->fill(0, N, 0x77));
+    osalDbgCheck(N == mtd->erase(0, N));
+    mtd->stats_get(&st);
+    /* erase is page programs of 0xFF or sector erases */
+    if (0 == es)
+      osalDbgCheck((st.programs == 2 * pages) && (0 == st.erases));
+    else
+      osalDbgCheck((st.programs == pages) && (st.erases == N / es));
+    osalDbgCheck((1 == st.op[MTD_OP_ERASE].ops) &&
+                 (N == st.op[MTD_OP_ERASE].bytes));
+  }
+#endif
+
+  /* whole device, verified by plain read back */
+  osalDbgCheck(mtd->capacity() == mtd->fill(0, mtd->capacity(), 0xFF));
+  check_erased(ctx);
+  dbgprint(ctx, "OK\r\n");
+}
+
+/*
+ *
+ */
+static void stats_test(nvram::TestContext *ctx) {
+#if MTD_USE_STATS
+  MtdBase *mtd = ctx->mtd;
+  MtdStats st;
+  const size_t len = 16;
+  uint32_t offset = 0;
+
+  dbgprint(ctx, "stats test ... ");
+
+  if (! mtd->is_fram())
+    offset = mtd->pagesize() - len / 2; /* cross page boundary */
+
+  mtd->stats_reset();
+  memset(ctx->mtdbuf, 0xA5, len);
+  osalDbgCheck(len == mtd->write(ctx->mtdbuf, len, offset));
+  osalDbgCheck(len == mtd->read(ctx->mtdbuf, len, offset));
+  mtd->stats_get(&st);
+
+  osalDbgCheck(1 == st.op[MTD_OP_WRITE].ops);
+  osalDbgCheck(len == st.op[MTD_OP_WRITE].bytes);
+  osalDbgCheck(1 == st.op[MTD_OP_READ].ops);
+  osalDbgCheck(len == st.op[MTD_OP_READ].bytes);
+  osalDbgCheck(0 == st.bus_errors);
+  if (mtd->is_fram()) {
+    osalDbgCheck((1 == st.programs) && (0 == st.splits));
+  }
+  else {
+    osalDbgCheck((2 == st.programs) && (1 == st.splits));
+  }
+
+  size_t hits = 0;
+  for (size_t i=0; i<MTD_STATS_BUCKETS; i++)
+    hits += st.op[MTD_OP_WRITE].hist[i];
+  osalDbgCheck(1 == hits);
+
+  osalDbgCheck(MSG_OK == nvramset(ctx, 0xFF));
+  dbgprint(ctx, "OK\r\n");
+#else
+  (void)ctx;
+#endif
+}
+
+/*
+ *
+ */
+static void trace_test(nvram::TestContext *ctx) {
+#if MTD_USE_TRACE
+  MtdBase *mtd = ctx->mtd;
+  mtd_trace_t t[2];
+
+  dbgprint(ctx, "trace test ... ");
+
+  memset(ctx->mtdbuf, 0x5A, 8);
+  osalDbgCheck(8 == mtd->write(ctx->mtdbuf, 8, 3));
+  osalDbgCheck(5 == mtd->read(ctx->mtdbuf, 5, 4));
+  osalDbgCheck(2 == mtd->trace_get(t, 2));
+
+  osalDbgCheck((MTD_OP_WRITE == t[0].op) && (3 == t[0].offset));
+  osalDbgCheck((8 == t[0].len) && (8 == t[0].done));
+  osalDbgCheck((MTD_OP_READ == t[1].op) && (4 == t[1].offset));
+  osalDbgCheck((5 == t[1].len) && (5 == t[1].done));
+  osalDbgCheck(t[0].thread == t[1].thread);
+
+  osalDbgCheck(MSG_OK == nvramset(ctx, 0xFF));
+  dbgprint(ctx, "OK\r\n");
+#else
+  (void)ctx;
+#endif
+}
+
+/*
+ * Writes uniform patterns over several pages.
+ */
+static THD_FUNCTION(lock_writer, arg) {
+  lock_test_t *lt = static_cast<lock_test_t *>(arg);
+
+  for (size_t i=0; i<LOCK_TEST_ROUNDS; i++) {
+    memset(lt->buf, (i & 1) ? 0x00 : 0xFF, lt->len);
+    osalDbgCheck(lt->len == lt->mtd->write(lt->buf, lt->len, 0));
+  }
+  lt->done->signal();
+}
+
+/*
+ * Writes random data until stopped.
+ */
+static THD_FUNCTION(lock_scrambler, arg) {
+  lock_test_t *lt = static_cast<lock_test_t *>(arg);
+
+  fill_random(lt->buf, lt->len);
+  lt->done->signal();
+  while (lt->run) {
+    osalDbgCheck(lt->len == lt->mtd->write(lt->buf, lt->len, 0));
+    lt->writes++;
+  }
+  lt->done->signal();
+}
+
+/*
+ *
+ */
+static void __lock_test(nvram::TestContext *ctx, size_t yield, bool atomic) {
+  chibios_rt::CounterSemaphore done(0);
+  lock_test_t lt;
+
+  lt.mtd  = ctx->mtd;
+  lt.buf  = ctx->refbuf;
+  lt.len  = ctx->mtd->is_fram() ? 512 : 4 * ctx->mtd->pagesize();
+  lt.done = &done;
+  lt.run  = true;
+  lt.writes = 0;
+
+  ctx->mtd->set_write_yield(yield);
+  chThdCreateStatic(lock_writer_wa, sizeof(lock_writer_wa), NORMALPRIO,
+                    lock_writer, &lt);
+
+  /* multi page write is never seen half done */
+  for (size_t i=0; i<LOCK_TEST_ROUNDS; i++) {
+    osalDbgCheck(lt.len == ctx->mtd->read(ctx->mtdbuf, lt.len, 0));
+    for (size_t n=1; atomic && (n<lt.len); n++)
+      osalDbgCheck(ctx->mtdbuf[0] == ctx->mtdbuf[n]);
+  }
+
+  done.wait();
+  ctx->mtd->set_write_yield(MTD_WRITE_YIELD_PAGES);
+
+  osalDbgCheck(lt.len == ctx->mtd->read(ctx->mtdbuf, lt.len, 0));
+  for (size_t n=0; n<lt.len; n++)
+    osalDbgCheck(0x00 == ctx->mtdbuf[n]);
+}
+
+/*
+ * Other writers use write buffer while fill() yields the lock,
+ * pattern must survive it.
+ */
+static void __lock_fill_test(nvram::TestContext *ctx) {
+  chibios_rt::CounterSemaphore done(0);
+  lock_test_t lt;
+
+  lt.mtd  = ctx->mtd;
+  lt.buf  = ctx->refbuf;
+  lt.len  = ctx->mtd->is_fram() ? 512 : 4 * ctx->mtd->pagesize();
+  lt.done = &done;
+  lt.run  = true;
+  lt.writes = 0;
+
+  if (ctx->mtd->capacity() < 2 * lt.len)
+    return;
+
+  ctx->mtd->set_write_yield(1);
+  chThdCreateStatic(lock_writer_wa, sizeof(lock_writer_wa), NORMALPRIO,
+                    lock_scrambler, &lt);
+  done.wait();
+
+  /* keep filling until the other thread really competed for device */
+  for (size_t i=0; (i<LOCK_TEST_ROUNDS) || (lt.writes<LOCK_TEST_ROUNDS); i++) {
+    const uint8_t pattern = (i & 1) ? 0x00 : 0xA5;
+    osalDbgCheck(lt.len == ctx->mtd->fill(lt.len, lt.len, pattern));
+    osalDbgCheck(lt.len == ctx->mtd->read(ctx->mtdbuf, lt.len, lt.len));
+    for (size_t n=0; n<lt.len; n++)
+      osalDbgCheck(pattern == ctx->mtdbuf[n]);
+  }
+
+  lt.run = false;
+  done.wait();
+  ctx->mtd->set_write_yield(MTD_WRITE_YIELD_PAGES);
+}
+
+/*
+ *
+ */
+static void lock_test(nvram::TestContext *ctx) {
+
+  if (ctx->mtd->capacity() < 512)
+    return;
+
+  dbgprint(ctx, "lock test ... ");
+  __lock_test(ctx, 0, true);
+  __lock_test(ctx, 1, false);
+  __lock_fill_test(ctx);
+  osalDbgCheck(MSG_OK == nvramset(ctx, 0xFF));
+  dbgprint(ctx, "OK\r\n");
+}
+
+/*
+ *
+ */
+static void calib_test(nvram::TestContext *ctx) {
+  MtdBase *mtd = ctx->mtd;
+  const size_t ps = mtd->pagesize();
+  MtdCalib c, prev;
+  bool ret;
+
+  if (mtd->is_fram() || (mtd->pagecount() < 2))
+    return;
+
+  dbgprint(ctx, "calibrate test ... ");
+
+  for (size_t i=0; i<ps; i++)
+    ctx->refbuf[i] = i * 7 + 1;
+  osalDbgCheck(ps == mtd->write(ctx->refbuf, ps, ps));
+
+  /* scratch content must survive calibration */
+  mtd->calib_get(&prev);
+  ret = mtd->calibrate(ps);
+  osalDbgCheck(ps == mtd->read(ctx->mtdbuf, ps, ps));
+  osalDbgCheck(0 == memcmp(ctx->mtdbuf, ctx->refbuf, ps));
+
+  mtd->calib_get(&c);
+  if (OSAL_SUCCESS == ret) {
+    /* samples under tick resolution are dropped */
+    osalDbgCheck((c.samples > 0) && (c.samples <= MTD_CALIB_ROUNDS));
+    osalDbgCheck(c.program_min_us >= ST2US(MTD_CALIB_MIN_TICKS));
+    osalDbgCheck(c.program_min_us <= c.program_avg_us);
+    osalDbgCheck(c.program_avg_us <= c.program_max_us);
+  }
+  else {
+    /* device too fast for system tick, previous result kept */
+    osalDbgCheck(0 == memcmp(&c, &prev, sizeof(c)));
+  }
+  osalDbgCheck(c.programtime == mtd->get_programtime());
+
+  osalDbgCheck(MSG_OK == nvramset(ctx, 0xFF));
+  dbgprint(ctx, "OK\r\n");
+}
+
+/*
+ *
+ */
+#if MTD_USE_WEAR
+static uint32_t wear_cnt[512];
+#endif
+static void wear_test(nvram::TestContext *ctx) {
+#if MTD_USE_WEAR
+  MtdBase *mtd = ctx->mtd;
+  const uint32_t bs = mtd->wear_blocksize();
+  const size_t blocks = mtd->capacity() / bs;
+  mtd_wear_t hot[2];
+
+  if ((blocks > (sizeof(wear_cnt) / sizeof(wear_cnt[0]))) || (blocks < 5))
+    return;
+
+  dbgprint(ctx, "wear test ... ");
+
+  /* erased region holds no valid counters */
+  osalDbgCheck(MSG_OK == nvramset(ctx, 0xFF));
+  osalDbgCheck(OSAL_FAILED == mtd->wear_start(wear_cnt, blocks, 0));
+  osalDbgCheck(0 == mtd->wear_hottest(hot, 2));
+
+  memset(ctx->mtdbuf, 0x5A, 8);
+  for (size_t i=0; i<3; i++)
+    osalDbgCheck(8 == mtd->write(ctx->mtdbuf, 8, 2*bs + 1));
+  osalDbgCheck(4 == mtd->write(ctx->mtdbuf, 4, 4*bs - 2));
+  osalDbgCheck((3 == wear_cnt[2]) && (1 == wear_cnt[3]) && (1 == wear_cnt[4]));
+  osalDbgCheck(2 == mtd->wear_hottest(hot, 2));
+  osalDbgCheck((2 == hot[0].block) && (3 == hot[0].count));
+  osalDbgCheck(1 == hot[1].count);
+
+  /* counters survive restart */
+  osalDbgCheck(OSAL_SUCCESS == mtd->wear_save());
+  memset(wear_cnt, 0, sizeof(wear_cnt));
+  osalDbgCheck(OSAL_SUCCESS == mtd->wear_start(wear_cnt, blocks, 0));
+  osalDbgCheck((3 == wear_cnt[2]) && (1 == wear_cnt[3]) && (1 == wear_cnt[4]));
+
+  /* damaged copy is rejected */
+  osalDbgCheck(1 == mtd->write(ctx->mtdbuf, 1, MTD_WEAR_REGION_SIZE(2)));
+  osalDbgCheck(OSAL_FAILED == mtd->wear_start(wear_cnt, blocks, 0));
+  osalDbgCheck(0 == wear_cnt[2]);
+
+  /* keep counting in RAM only, following tests overwrite region */
+  mtd->wear_start(wear_cnt, blocks, MTD_WEAR_NO_REGION);
+  osalDbgCheck(MSG_OK == nvramset(ctx, 0xFF));
+  dbgprint(ctx, "OK\r\n");
+#else
+  (void)ctx;
+#endif
+}
+
+/*
+ * Deferred writes are queued while device sleeps and written in one
+ * wake: by next operation or after deferral window.
+ */
+#if MTD_USE_POWER
+static uint8_t defer_pool[4 * (16 + 8)];
+static void __defer_test(nvram::TestContext *ctx) {
+  MtdBase *mtd = ctx->mtd;
+  const size_t len = 16;
+  const systime_t window = MS2ST(10);
+
+  mtd->defer_start(defer_pool, sizeof(defer_pool), window);
+  fill_random(ctx->refbuf, 9*len);
+
+  /* read sees queued data, device wakes once for both */
+  osalDbgCheck(OSAL_SUCCESS == mtd->power_down());
+#if MTD_USE_STATS
+  mtd->stats_reset();
+#endif
+  for (size_t i=0; i<4; i++)
+    osalDbgCheck(len == mtd->write_deferred(&ctx->refbuf[i*len], len, i*len));
+  osalDbgCheck(! mtd->is_awake());
+  osalDbgCheck(4 * (len + 8) == mtd->deferred());
+  osalDbgCheck(4*len == mtd->read(ctx->mtdbuf, 4*len, 0));
+  osalDbgCheck(0 == memcmp(ctx->mtdbuf, ctx->refbuf, 4*len));
+  osalDbgCheck(0 == mtd->deferred());
+#if MTD_USE_STATS
+  MtdStats st;
+  mtd->stats_get(&st);
+  osalDbgCheck(1 == st.wakeups);
+#endif
+
+  /* awake device is written at once */
+  osalDbgCheck(len == mtd->write_deferred(&ctx->refbuf[4*len], len, 4*len));
+  osalDbgCheck(0 == mtd->deferred());
+
+  /* power manager writes queue after window */
+  osalDbgCheck(OSAL_SUCCESS == mtd->power_down());
+  osalDbgCheck(len == mtd->write_deferred(&ctx->refbuf[5*len], len, 5*len));
+  osalDbgCheck(mtd->power_idle() <= window);
+  osalDbgCheck(! mtd->is_awake() && (0 != mtd->deferred()));
+  osalThreadSleep(window);
+  mtd->power_idle();
+  osalDbgCheck(mtd->is_awake() && (0 == mtd->deferred()));
+
+  /* write not fitting in queue goes to device after queued ones */
+  osalDbgCheck(OSAL_SUCCESS == mtd->power_down());
+  for (size_t i=4; i<8; i++)
+    osalDbgCheck(len == mtd->write_deferred(&ctx->refbuf[i*len], len, i*len));
+  osalDbgCheck(sizeof(defer_pool) == mtd->deferred());
+  osalDbgCheck(len == mtd->write_deferred(&ctx->refbuf[8*len], len, 8*len));
+  osalDbgCheck(0 == mtd->deferred());
+
+  osalDbgCheck(9*len == mtd->read(ctx->mtdbuf, 9*len, 0));
+  osalDbgCheck(0 == memcmp(ctx->mtdbuf, ctx->refbuf, 9*len));
+  mtd->defer_start(nullptr, 0, 0);
+}
+#endif /* MTD_USE_POWER */
+
+/*
+ *
+ */
+static void power_test(nvram::TestContext *ctx) {
+#if MTD_USE_POWER
+  MtdBase *mtd = ctx->mtd;
+  const size_t len = 16;
+  systime_t left;
+
+  dbgprint(ctx, "power test ... ");
+
+  memset(ctx->refbuf, 0xA5, len);
+  osalDbgCheck(OSAL_SUCCESS == mtd->power_down());
+  osalDbgCheck(! mtd->is_awake());
+  osalDbgCheck(OSAL_SUCCESS == mtd->power_down());
+
+#if MTD_USE_STATS
+  mtd->stats_reset();
+#endif
+  /* batch of operations wakes device once */
+  for (size_t i=0; i<4; i++)
+    osalDbgCheck(len == mtd->write(ctx->refbuf, len, i * len));
+  osalDbgCheck(4*len == mtd->read(ctx->mtdbuf, 4*len, 0));
+  osalDbgCheck(mtd->is_awake());
+#if MTD_USE_STATS
+  MtdStats st;
+  mtd->stats_get(&st);
+  osalDbgCheck(1 == st.wakeups);
+#endif
+
+  /* auto sleep after idle time */
+  left = mtd->power_idle();
+  osalDbgCheck(mtd->is_awake());
+  if (0 != left) {
+    osalThreadSleep(left);
+    mtd->power_idle();
+    osalDbgCheck(! mtd->is_awake());
+  }
+
+  __defer_test(ctx);
+
+  osalDbgCheck(MSG_OK == nvramset(ctx, 0xFF));
+  osalDbgCheck(mtd->is_awake());
+  dbgprint(ctx, "OK\r\n");
+#else
+  (void)ctx;
+#endif
+}
+
+/*
+ * Write through shadow without dirty map must report failed device
+ * write, there is nothing to remember it in.
+ */
+static void __shadow_fail_test(void) {
+  static uint8_t mirror[BROKEN_MTD_SIZE];
+  uint8_t data[8];
+  BrokenMtd broken(broken_mtd_cfg);
+  MtdShadow shadow(broken, mirror, nullptr, false);
+
+  osalDbgCheck(OSAL_SUCCESS == shadow.start());
+  memset(data, 0x5A, sizeof(data));
+  osalDbgCheck(sizeof(data) != shadow.write(data, sizeof(data), 3));
+  osalDbgCheck(0 == shadow.dirty_count());
+  osalDbgCheck(OSAL_SUCCESS == shadow.flush());
+}
+
+/*
+ *
+ */
+static void shadow_test(nvram::TestContext *ctx) {
+  MtdBase *mtd = ctx->mtd;
+  size_t blocks = mtd->pagecount();
+
+  if (mtd->is_fram())
+    blocks = mtd->capacity() / MTD_SHADOW_FRAM_BLOCK_SIZE;
+
+  /* mirror lives in filebuf */
+  if ((ctx->len < mtd->capacity()) || (MTD_SHADOW_DIRTYMAP_SIZE(blocks) > 128))
+    return;
+
+  dbgprint(ctx, "shadow test ... ");
+  __shadow_test(ctx, false);
+  __shadow_test(ctx, true);
+  __shadow_fail_test();
+  osalDbgCheck(MSG_OK == nvramset(ctx, 0xFF));
+  dbgprint(ctx, "OK\r\n");
+}
+
 /*
  *
  */
@@ -509,6 +1335,263 @@ static void file_put_test(nvram::TestContext *ctx) {
   dbgprint(ctx, "OK\r\n");
 }
 
+/*
+ *
+ */
+static void __file_stream_test(nvram::TestContext *ctx, size_t offset, size_t len) {
+
+  MtdBase *mtd = ctx->mtd;
+  uint8_t *mtdbuf = ctx->mtdbuf;
+  uint8_t *refbuf = ctx->refbuf;
+  File f;
+  size_t status;
+
+  for (size_t i=0; i<len; i++)
+    refbuf[i] = i * 7 + 1;
+
+  memset(mtdbuf, 0, ctx->len);
+  mtd->write(mtdbuf, len + 1, offset);
+
+  /* gathered write */
+  f.__test_ctor(mtd, offset, len);
+  for (size_t i=0; i<len; i++)
+    osalDbgCheck(MSG_OK == f.put(refbuf[i]));
+  osalDbgCheck(MSG_RESET == f.put(0x55));
+  osalDbgCheck(OSAL_SUCCESS == f.flush());
+
+  status = mtd->read(mtdbuf, len + 1, offset);
+  osalDbgCheck(len + 1 == status);
+  osalDbgCheck(0 == memcmp(refbuf, mtdbuf, len));
+  osalDbgCheck(0 == mtdbuf[len]);
+
+  /* read ahead */
+  f.setPosition(0);
+  for (size_t i=0; i<len; i++)
+    osalDbgCheck(refbuf[i] == f.get());
+  osalDbgCheck(MSG_RESET == f.get());
+
+  /* mixed access must stay coherent */
+  f.setPosition(1);
+  osalDbgCheck(MSG_OK == f.put(0xAA));
+  f.setPosition(0);
+  osalDbgCheck(refbuf[0] == f.get());
+  osalDbgCheck(0xAA == f.get());
+  f.setPosition(0);
+  osalDbgCheck(1 == f.write(&refbuf[1], 1));
+  f.setPosition(0);
+  osalDbgCheck(refbuf[1] == f.get());
+}
+
+/*
+ * Sequential put() programs every page once per buffer fill.
+ */
+static void __file_put_programs_test(nvram::TestContext *ctx) {
+#if MTD_USE_STATS
+  MtdBase *mtd = ctx->mtd;
+  const size_t pagesize = mtd->pagesize();
+  const size_t len = 2 * pagesize;
+  const size_t per_page = (pagesize + NVRAM_FILE_CACHE_SIZE - 1)
+                                              / NVRAM_FILE_CACHE_SIZE;
+  MtdStats st;
+  File f;
+
+  f.__test_ctor(mtd, pagesize, len);
+  mtd->stats_reset();
+  for (size_t i=0; i<len; i++)
+    osalDbgCheck(MSG_OK == f.put(i));
+  osalDbgCheck(OSAL_SUCCESS == f.flush());
+  mtd->stats_get(&st);
+  osalDbgCheck(2 * per_page == st.programs);
+#else
+  (void)ctx;
+#endif
+}
+
+/*
+ *
+ */
+static void file_stream_test(nvram::TestContext *ctx) {
+  const size_t pagesize = ctx->mtd->pagesize();
+
+  dbgprint(ctx, "file stream test ... ");
+
+  if (ctx->mtd->pagecount() > 1) {
+    __file_stream_test(ctx, 0, pagesize);
+    __file_stream_test(ctx, 1, pagesize);
+    __file_stream_test(ctx, pagesize - 1, 3 * pagesize + 2);
+    __file_put_programs_test(ctx);
+  }
+  else {
+    __file_stream_test(ctx, 0, 2);
+    __file_stream_test(ctx, 3, 100);
+  }
+
+  dbgprint(ctx, "OK\r\n");
+}
+
+/*
+ *
+ */
+struct __attribute__((packed)) test_record_t {
+  uint8_t   a;
+  uint32_t  b;
+  float     c;
+  char      d[5];
+};
+
+/*
+ *
+ */
+static void file_array_test(nvram::TestContext *ctx) {
+
+  MtdBase *mtd = ctx->mtd;
+  uint8_t *mtdbuf = ctx->mtdbuf;
+  const size_t N = 100;
+  uint16_t u16[N], ret_u16[N];
+  uint32_t u32[N], ret_u32[N];
+  test_record_t rec = {0x11, 0x22334455, 1.5f, "abcd"};
+  test_record_t ret_rec;
+  File f;
+
+  dbgprint(ctx, "file array test ... ");
+
+  for (size_t i=0; i<N; i++) {
+    u16[i] = i * 1000 + 1;
+    u32[i] = i * 100000 + 1;
+  }
+
+  f.__test_ctor(mtd, 3, sizeof(u16) + sizeof(u32) + sizeof(rec));
+  osalDbgCheck(N == f.write_array(u16, N));
+  osalDbgCheck(N == f.write_array(u32, N));
+  osalDbgCheck(OSAL_SUCCESS == f.write_record(rec));
+  osalDbgCheck(0 == f.write_array(u16, 1)); /* end of file reached */
+
+  f.setPosition(0);
+  osalDbgCheck(N == f.read_array(ret_u16, N));
+  osalDbgCheck(N == f.read_array(ret_u32, N));
+  osalDbgCheck(OSAL_SUCCESS == f.read_record(&ret_rec));
+  osalDbgCheck(0 == memcmp(u16, ret_u16, sizeof(u16)));
+  osalDbgCheck(0 == memcmp(u32, ret_u32, sizeof(u32)));
+  osalDbgCheck(0 == memcmp(&rec, &ret_rec, sizeof(rec)));
+
+  /* arrays must be stored in little endian byte order */
+  mtd->read(mtdbuf, 4, 3 + sizeof(u16) + sizeof(uint32_t));
+  osalDbgCheck(0xA1 == mtdbuf[0]);
+  osalDbgCheck(0x86 == mtdbuf[1]);
+  osalDbgCheck(0x01 == mtdbuf[2]);
+  osalDbgCheck(0x00 == mtdbuf[3]);
+
+  dbgprint(ctx, "OK\r\n");
+}
+
+/*
+ *
+ */
+static void __legacy_format_test(nvram::TestContext *ctx, fs_format_t format) {
+
+  MtdBase *mtd = ctx->mtd;
+  Fs nvfs(*mtd);
+  File *test0, *tail;
+  size_t df;
+  uint8_t b;
+
+  nvramset(ctx, 0xFF);
+  osalDbgCheck(OSAL_SUCCESS == nvfs.mkfs(format));
+  osalDbgCheck(OSAL_SUCCESS == nvfs.mount());
+  osalDbgCheck(format == nvfs.get_format());
+
+  df = nvfs.df();
+  if (FS_FORMAT_V0 == format)
+    osalDbgCheck(df <= 0xFFFF);
+  osalDbgCheck(nullptr == nvfs.create("test0", df + 1));
+  test0 = nvfs.create("test0", 64);
+  osalDbgCheck(nullptr != test0);
+  file_test(test0);
+  nvfs.close(test0);
+
+  /* the rest of space up to the last byte of part up to 64 KiB */
+  df = nvfs.df();
+  if (df > 0) {
+    tail = nvfs.create("tail", df);
+    osalDbgCheck(nullptr != tail);
+    osalDbgCheck(0 == nvfs.df());
+    b = 0x3C;
+    osalDbgCheck(FILE_OK == tail->setPosition(df - 1));
+    osalDbgCheck(1 == tail->write(&b, 1));
+    nvfs.close(tail);
+    if (mtd->capacity() <= 0x10000) {
+      b = 0;
+      osalDbgCheck(1 == mtd->read(&b, 1, mtd->capacity() - 1));
+      osalDbgCheck(0x3C == b);
+    }
+  }
+
+  osalDbgCheck(OSAL_SUCCESS == nvfs.umount());
+  osalDbgCheck(OSAL_SUCCESS == nvfs.mount());
+  osalDbgCheck(format == nvfs.get_format());
+  test0 = nvfs.open("test0");
+  osalDbgCheck(nullptr != test0);
+  osalDbgCheck(64 == test0->getSize());
+  nvfs.close(test0);
+  osalDbgCheck(OSAL_SUCCESS == nvfs.umount());
+}
+
+/*
+ *
+ */
+static void legacy_format_test(nvram::TestContext *ctx) {
+
+  dbgprint(ctx, "legacy format test ... ");
+  __legacy_format_test(ctx, FS_FORMAT_V0);
+  __legacy_format_test(ctx, FS_FORMAT_V1);
+  dbgprint(ctx, "OK\r\n");
+}
+
+/*
+ *
+ */
+static void aligned_creation_test(nvram::TestContext *ctx) {
+
+  MtdBase *mtd = ctx->mtd;
+  Fs nvfs(*mtd);
+  File *f;
+  uint32_t df, start;
+
+  dbgprint(ctx, "aligned creation test ... ");
+  nvramset(ctx, 0xFF);
+  osalDbgCheck(OSAL_SUCCESS == nvfs.mkfs());
+  osalDbgCheck(OSAL_SUCCESS == nvfs.mount());
+
+  /* misalign free space pointer intentionally */
+  f = nvfs.create("test0", 3);
+  osalDbgCheck(nullptr != f);
+  nvfs.close(f);
+
+  /* page aligned file */
+  df = nvfs.df(Fs::ALIGN_PAGE);
+  osalDbgCheck(df <= nvfs.df());
+  f = nvfs.create("test1", 2 * 32, Fs::ALIGN_PAGE);
+  osalDbgCheck(nullptr != f);
+  osalDbgCheck(nvfs.df() == df - 2 * 32);
+  start = mtd->capacity() - df;
+  if (mtd->pagecount() > 1)
+    osalDbgCheck(0 == start % mtd->pagesize());
+  file_test(f);
+  nvfs.close(f);
+
+  /* custom alignment */
+  df = nvfs.df(16);
+  f = nvfs.create("test2", 5, 16);
+  osalDbgCheck(nullptr != f);
+  osalDbgCheck(nvfs.df() == df - 5);
+  start = mtd->capacity() - df;
+  osalDbgCheck(0 == start % 16);
+  nvfs.close(f);
+
+  osalDbgCheck(OSAL_SUCCESS == nvfs.umount());
+  dbgprint(ctx, "OK\r\n");
+}
+
 /*
  *
  */
@@ -524,6 +1607,7 @@ void mkfs_and_mount_test(nvram::TestContext *ctx) {
   osalDbgCheck(OSAL_SUCCESS == nvfs.mkfs());
   osalDbgCheck(OSAL_SUCCESS == nvfs.fsck());
   osalDbgCheck(OSAL_SUCCESS == nvfs.mount());
+  osalDbgCheck(FS_FORMAT_DEFAULT == nvfs.get_format());
   dbgprint(ctx, "OK\r\n");
 }
 
@@ -584,6 +1668,183 @@ static void file_creation_test(nvram::TestContext *ctx) {
   dbgprint(ctx, "OK\r\n");
 }
 
+/*
+ *
+ */
+static void transaction_test(nvram::TestContext *ctx) {
+
+  MtdBase *mtd = ctx->mtd;
+  uint8_t *mtdbuf = ctx->mtdbuf;
+  uint8_t *refbuf = ctx->refbuf;
+  uint8_t *filebuf = ctx->filebuf;
+  const size_t N = 100;
+  const size_t jpage = (mtd->pagecount() > 1) ? mtd->pagesize() : 16;
+  Fs nvfs(*mtd);
+  File *f0, *f1;
+
+  dbgprint(ctx, "transaction test ... ");
+  nvramset(ctx, 0xFF);
+  osalDbgCheck(OSAL_SUCCESS == nvfs.mkfs());
+  osalDbgCheck(OSAL_SUCCESS == nvfs.mount());
+
+  /* no journal yet */
+  osalDbgCheck(OSAL_FAILED == nvfs.begin());
+  osalDbgCheck(nullptr == nvfs.create(NVRAM_FS_JOURNAL_NAME, 64));
+  osalDbgCheck(OSAL_SUCCESS == nvfs.mkjournal(4 * N + jpage));
+  osalDbgCheck(OSAL_FAILED == nvfs.mkjournal(64));
+  osalDbgCheck(nullptr == nvfs.open(NVRAM_FS_JOURNAL_NAME));
+
+  f0 = nvfs.create("test0", N);
+  f1 = nvfs.create("test1", N);
+  osalDbgCheck((nullptr != f0) && (nullptr != f1));
+  memset(refbuf, 0x11, N);
+  osalDbgCheck(N == f0->write(refbuf, N));
+  osalDbgCheck(N == f1->write(refbuf, N));
+
+  /* aborted transaction leaves files untouched */
+  memset(mtdbuf, 0x22, N);
+  osalDbgCheck(OSAL_SUCCESS == nvfs.begin());
+  osalDbgCheck(OSAL_FAILED == nvfs.begin());
+  f0->setPosition(0);
+  osalDbgCheck(N == f0->write(mtdbuf, N));
+  f1->setPosition(0);
+  osalDbgCheck(MSG_OK == f1->put(0x22));
+  nvfs.abort();
+  f0->setPosition(0);
+  osalDbgCheck(N == f0->read(mtdbuf, N));
+  osalDbgCheck(0 == memcmp(refbuf, mtdbuf, N));
+  f1->setPosition(0);
+  osalDbgCheck(0x11 == f1->get());
+
+  /* nothing changes until commit */
+  osalDbgCheck(OSAL_SUCCESS == nvfs.begin());
+  memset(mtdbuf, 0x33, N);
+  f0->setPosition(0);
+  osalDbgCheck(N == f0->write(mtdbuf, N));
+  f1->setPosition(N / 2);
+  for (size_t i=0; i<N/2; i++)
+    osalDbgCheck(MSG_OK == f1->put(0x44));
+  f0->setPosition(0);
+  osalDbgCheck(N == f0->read(mtdbuf, N));
+  osalDbgCheck(0 == memcmp(refbuf, mtdbuf, N));
+  osalDbgCheck(OSAL_SUCCESS == nvfs.commit());
+
+  memset(refbuf, 0x33, N);
+  f0->setPosition(0);
+  osalDbgCheck(N == f0->read(mtdbuf, N));
+  osalDbgCheck(0 == memcmp(refbuf, mtdbuf, N));
+  memset(refbuf, 0x11, N / 2);
+  memset(refbuf + N / 2, 0x44, N / 2);
+  f1->setPosition(0);
+  osalDbgCheck(N == f1->read(mtdbuf, N));
+  osalDbgCheck(0 == memcmp(refbuf, mtdbuf, N));
+
+  /* journal overflow fails the whole transaction */
+  osalDbgCheck(OSAL_SUCCESS == nvfs.begin());
+  for (size_t i=0; i<20; i++) {
+    f0->setPosition(0);
+    f0->write(mtdbuf, N);
+  }
+  osalDbgCheck(OSAL_FAILED == nvfs.commit());
+  f1->setPosition(0);
+  osalDbgCheck(N == f1->read(mtdbuf, N));
+  osalDbgCheck(0 == memcmp(refbuf, mtdbuf, N));
+
+#if MTD_USE_STATS
+  /* journal must stay within twice rewrite-then-verify programs plus
+     commit record, its clear and one page of unaligned payload */
+  {
+    MtdStats st;
+    uint32_t plain;
+    memset(refbuf, 0x66, N);
+    mtd->stats_reset();
+    f0->setPosition(0);
+    osalDbgCheck(N == f0->write(refbuf, N));
+    f1->setPosition(0);
+    osalDbgCheck(N == f1->write(refbuf, N));
+    f0->setPosition(0);
+    osalDbgCheck(N == f0->read(mtdbuf, N));
+    osalDbgCheck(0 == memcmp(refbuf, mtdbuf, N));
+    f1->setPosition(0);
+    osalDbgCheck(N == f1->read(mtdbuf, N));
+    osalDbgCheck(0 == memcmp(refbuf, mtdbuf, N));
+    mtd->stats_get(&st);
+    plain = st.programs;
+
+    mtd->stats_reset();
+    osalDbgCheck(OSAL_SUCCESS == nvfs.begin());
+    f0->setPosition(0);
+    osalDbgCheck(N == f0->write(refbuf, N));
+    f1->setPosition(0);
+    osalDbgCheck(N == f1->write(refbuf, N));
+    osalDbgCheck(OSAL_SUCCESS == nvfs.commit());
+    mtd->stats_get(&st);
+    osalDbgCheck(st.programs <= 2 * plain + 3);
+  }
+#endif
+
+  /* reset after commit record: home data is untouched until mount
+     replays the journal */
+  memcpy(filebuf, refbuf, N);
+  f1->setPosition(0);
+  osalDbgCheck(N == f1->read(filebuf, N));
+  osalDbgCheck(OSAL_SUCCESS == nvfs.begin());
+  memset(mtdbuf, 0x55, N);
+  f0->setPosition(0);
+  osalDbgCheck(N == f0->write(mtdbuf, N));
+  f1->setPosition(0);
+  osalDbgCheck(N / 2 == f1->write(mtdbuf, N / 2));
+  osalDbgCheck(OSAL_SUCCESS == nvfs.__test_commit_crash());
+  f1->setPosition(0);
+  osalDbgCheck(N == f1->read(mtdbuf, N));
+  osalDbgCheck(0 == memcmp(filebuf, mtdbuf, N));
+  nvfs.close(f0);
+  nvfs.close(f1);
+  osalDbgCheck(OSAL_SUCCESS == nvfs.umount());
+  osalDbgCheck(OSAL_SUCCESS == nvfs.mount());
+  f0 = nvfs.open("test0");
+  f1 = nvfs.open("test1");
+  osalDbgCheck((nullptr != f0) && (nullptr != f1));
+  memset(refbuf, 0x55, N);
+  osalDbgCheck(N == f0->read(mtdbuf, N));
+  osalDbgCheck(0 == memcmp(refbuf, mtdbuf, N));
+  memcpy(&refbuf[N / 2], &filebuf[N / 2], N - N / 2);
+  osalDbgCheck(N == f1->read(mtdbuf, N));
+  osalDbgCheck(0 == memcmp(refbuf, mtdbuf, N));
+
+  /* replayed journal is cleared, next mount keeps newer data */
+  osalDbgCheck(OSAL_SUCCESS == nvfs.begin());
+  memset(mtdbuf, 0x77, N);
+  f0->setPosition(0);
+  osalDbgCheck(N == f0->write(mtdbuf, N));
+  osalDbgCheck(OSAL_SUCCESS == nvfs.commit());
+  nvfs.close(f0);
+  nvfs.close(f1);
+  osalDbgCheck(OSAL_SUCCESS == nvfs.umount());
+  osalDbgCheck(OSAL_SUCCESS == nvfs.mount());
+  f0 = nvfs.open("test0");
+  f1 = nvfs.open("test1");
+  osalDbgCheck((nullptr != f0) && (nullptr != f1));
+  osalDbgCheck(N == f0->read(filebuf, N));
+  osalDbgCheck(0 == memcmp(mtdbuf, filebuf, N));
+
+  /* unfinished transaction must be discarded by mount */
+  osalDbgCheck(OSAL_SUCCESS == nvfs.begin());
+  f1->setPosition(0);
+  osalDbgCheck(N == f1->write(mtdbuf, N));
+  nvfs.close(f0);
+  nvfs.close(f1);
+  osalDbgCheck(OSAL_SUCCESS == nvfs.umount());
+  osalDbgCheck(OSAL_SUCCESS == nvfs.mount());
+  f1 = nvfs.open("test1");
+  osalDbgCheck(N == f1->read(mtdbuf, N));
+  osalDbgCheck(0 == memcmp(refbuf, mtdbuf, N));
+  nvfs.close(f1);
+  osalDbgCheck(OSAL_SUCCESS == nvfs.umount());
+
+  dbgprint(ctx, "OK\r\n");
+}
+
 /*
  ******************************************************************************
  * EXPORTED FUNCTIONS
@@ -615,8 +1876,26 @@ bool nvram::TestSuite(TestContext *ctx) {
     eeprom_write_align_check(ctx);
     eeprom_write_misalign_check(ctx);
   }
+  vector_io_test(ctx);
+  read_batch_test(ctx);
+  read_stream_test(ctx);
+  copy_test(ctx);
+  fill_test(ctx);
+  blank_compare_test(ctx);
+  stats_test(ctx);
+  trace_test(ctx);
+  lock_test(ctx);
+  calib_test(ctx);
+  wear_test(ctx);
+  power_test(ctx);
+  shadow_test(ctx);
   addres_translate_test(ctx);
   file_put_test(ctx);
+  file_stream_test(ctx);
+  file_array_test(ctx);
+  legacy_format_test(ctx);
+  aligned_creation_test(ctx);
+  transaction_test(ctx);
   mkfs_and_mount_test(ctx);
   file_creation_test(ctx);
 
@@ -27,6 +27,8 @@
 #define eeprom_led_off()          red_led_off()
 
 #define MTD_USE_MUTUAL_EXCLUSION  TRUE
-#define MTD_WRITE_BUF_SIZE        (32 + 2)
+/* FRAM has no pages, I2C write can not be split in DMA segments, so
+   buffer size is the longest single transaction: address + 256 bytes */
+#define MTD_WRITE_BUF_SIZE        (256 + 2)
 
 #endif /* MTD_CONF_H_ */
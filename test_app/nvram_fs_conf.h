@@ -29,4 +29,8 @@
 #define NVRAM_FS_MAX_FILE_CNT             3
 #endif
 
+#if !defined(NVRAM_FILE_CACHE_SIZE)
+#define NVRAM_FILE_CACHE_SIZE             32
+#endif
+
 #endif /* NVRAM_FS_CONF_H_ */